@@ -12,6 +12,14 @@ static const char * lidrup_check_usage =
 "  -n | --no-reuse  do not reuse clause identifiers\n"
 "  -q | --quiet     do not print any message beside errors\n"
 "  -v | --verbose   print more verbose message too\n"
+"  --backward       only check lemmas needed for unsatisfiable cores\n"
+"  --compact <n>    compact clauses if '<n>' bytes wasted (default 16 MB)\n"
+"  --follow         keep reading files still written (like 'tail -f')\n"
+"  --follow-timeout <s>\n"
+"                   without leases stop following after '<s>' idle seconds\n"
+"  --idrup          check non-linear IDRUP proof without identifiers\n"
+"  --propagate      fall back to unit propagation for incomplete hints\n"
+"  --threads <n>    check lemmas in parallel with '<n>' worker threads\n"
 "  --version        print version and exit\n"
 "\n"
 
@@ -53,12 +61,25 @@ static const char * lidrup_check_usage =
 "lines are assumed to match those of the user and are thus not checked\n"
 "but the rest of the checking works exactly in the same way.\n"
 
+"\n"
+
+"Compressed files are detected by their magic number and decompressed\n"
+"on-the-fly with 'bzip2', 'gzip', 'xz' or 'zstd' in a separate process.\n"
+"Files in the compact binary format are detected by their first byte.\n"
+"Header lines 'p icnf' and 'p lidrup' may give size hints, i.e., the\n"
+"maximum variable, the number of clauses and the maximum clause\n"
+"identifier, as in 'p lidrup 1000 5000 8000', to allocate tables once.\n"
+"Either file can be given as '-' to read it from '<stdin>'.  Both files\n"
+"can also be (named) pipes written by the solver while checking.\n"
+
 ;
 
 // clang-format on
 
 /*------------------------------------------------------------------------*/
 
+#define _GNU_SOURCE // For 'F_GETPIPE_SZ' and 'F_SETPIPE_SZ'.
+
 #include "lidrup-build.h"
 
 /*------------------------------------------------------------------------*/
@@ -67,12 +88,15 @@ static const char * lidrup_check_usage =
 #include <ctype.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
 
 /*------------------------------------------------------------------------*/
 
@@ -96,6 +120,12 @@ struct ids {
   int64_t *begin, *end, *allocated;
 };
 
+// Generic stack for positions of clauses and lemmas.
+
+struct positions {
+  unsigned *begin, *end, *allocated;
+};
+
 // Parsed line.
 
 struct line {
@@ -104,6 +134,39 @@ struct line {
   struct ids ids;
 };
 
+// Non-mapped files are read ahead by a separate reader thread into a
+// queue of chunks, which the parser consumes one after the other.
+
+struct chunk {
+  struct chunk *next; // Next chunk in queue or free list.
+  size_t size;        // Bytes actually read into 'chars'.
+  char chars[];       // The actual read buffer ('chunk_size' bytes).
+};
+
+struct reader {
+  pthread_t thread;        // Reading ahead in this thread.
+  pthread_mutex_t mutex;   // Protects all the fields below.
+  pthread_cond_t filled;   // Signalled after a chunk has been read.
+  pthread_cond_t consumed; // Signalled after a chunk has been parsed.
+  struct chunk *first;     // First read chunk not parsed yet.
+  struct chunk *last;      // Last read chunk not parsed yet.
+  struct chunk *free;      // Recycled chunks.
+  struct chunk *current;   // Chunk currently parsed by the checker.
+  struct chunk *reading;   // Chunk currently read by the reader thread.
+  size_t queued;           // Number of chunks between 'first' and 'last'.
+  size_t chunk_size;       // Bytes read at most at once.
+  bool unbounded;          // Read ahead without limit (two pipes).
+  bool follow;             // Wait at end-of-file for more data.
+  bool writer_closed;      // Writer of followed file closed it.
+  bool no_lease;           // Leases on followed file not available.
+  int inotify;             // Notifying about changes of followed file.
+  off_t size;              // Last seen size of followed file.
+  double unchanged;        // Time since which that size did not change.
+  bool end_of_file;        // Reader thread reached end-of-file.
+  bool closing;            // Tell reader thread to stop.
+  int error;               // Saved 'errno' of failed 'read'.
+};
+
 // We are reading interleaved from two files in parallel.
 
 struct file {
@@ -111,14 +174,25 @@ struct file {
   const char *name;      // Actual path to this file.
   size_t lines;          // Proof lines read from this file.
   size_t lineno;         // Line number of lines parsed so far.
-  size_t colno;          // Number of characters parsed in the line.
-  size_t charno;         // Number of bytes parsed.
   size_t start_of_line;  // Line number of current proof line.
+  size_t line_position;  // Position of the start of the current line.
+  size_t line_returns;   // Carriage returns before the current line.
+  size_t returns;        // Carriage returns parsed so far.
+  size_t offset;         // Position of the buffer in the file.
   bool end_of_file;      // Buffer 'read-char' detected end-of-file.
-  char last_char;        // Saved last char for bumping 'lineno'.
+  bool mapped;           // Regular file read through memory mapping.
+  bool closed;           // Decompression pipe already closed.
+  size_t file_size;      // Size of a mapped file in bytes.
+  size_t mapped_bytes;   // End of the current mapped window in the file.
   size_t end_buffer;     // End of remaining characters in buffer.
   size_t size_buffer;    // Current position (bytes parsed) in buffer.
-  char buffer[1u << 20]; // The actual buffer (1MB).
+  char *chars;           // Current read-ahead chunk or mapped window.
+  struct reader *reader; // Read-ahead thread for non-mapped files.
+  bool detected;         // Format (binary or text) determined.
+  bool binary;           // File in binary format.
+  int64_t last_id;       // Last clause identifier in binary format.
+  const char *decompressor; // Command decompressing a compressed file.
+  pid_t pid;                // Process of the decompressor.
 };
 
 struct clause {
@@ -129,17 +203,68 @@ struct clause {
   bool input;        // Input clauses are never freed.
   bool weakened;     // Weakened clauses are inactive.
   bool tautological; // Tautological clauses are always satisfied.
-  unsigned size;     // The actual allocated size of 'lits'.
-  int lits[];        // Flexible array member: lits[0], ..., lits[size-1].
+  unsigned char width; // Bytes per literal in 'lits' (1, 2 or 4).
+  unsigned size;       // The actual allocated size of 'lits'.
+  unsigned epoch;      // Weakening epoch of weakened clauses.
+  unsigned position;   // In input clauses, lemma log or watchers.
+  struct clause *prev_weakened, *next_weakened; // Weakened clause list.
+  int lits[]; // Flexible array member with 'size' literals of 'width'.
 };
 
 struct clauses {
   struct clause **begin, **end, **allocated;
 };
 
+// Weakened clauses stay in the clause index and are only flagged as
+// 'weakened'.  They are further kept in doubly linked lists through the
+// clauses themselves in the order they were weakened, which allows to
+// restore them in constant time.  There is one such list for each epoch
+// of weakening.  An epoch consists of all clauses weakened since the last
+// 'r' line or conclusion of a query.  Incremental solvers usually restore
+// all clauses they weakened before the next query.  Then an 'r' line
+// lists exactly the clauses of the last epochs, which can be checked by
+// simply walking their lists (see 'restore_epochs').
+
+struct epoch {
+  struct clause *first, *last;
+  size_t count;
+};
+
+struct epochs {
+  struct epoch *begin, *end, *allocated;
+};
+
+// The clause identifiers of hash table entries are kept in a separate
+// array 'keys' parallel to 'table' such that probing only scans the
+// densely packed keys (eight per cache line) and never touches clauses
+// except for the one found.  Empty slots have key zero (clause
+// identifiers are positive).
+
 struct hash_table {
+  int64_t *keys;
   struct clause **table;
   size_t count, size;
+  size_t reserved;        // Do not shrink below this size.
+  struct id_page **pages; // Directly indexed pages (see 'direct_id').
+  size_t num_pages;       // Allocated size of 'pages'.
+  size_t max_page;        // Maximum index of an allocated page.
+};
+
+struct id_page {
+  size_t count;           // Number of clauses in this page.
+  struct clause *slots[]; // Clauses indexed by identifier.
+};
+
+// Clauses are allocated in arenas or large blocks (see 'allocate_clause').
+
+struct block {
+  struct block *prev, *next; // Doubly linked list of blocks.
+  size_t bytes;              // Size of 'memory' in bytes.
+  char memory[];             // Clauses are allocated in here.
+};
+
+struct free_clause {
+  struct free_clause *next; // Overlays the freed clause.
 };
 
 struct bit_table {
@@ -149,16 +274,16 @@ struct bit_table {
 
 /*------------------------------------------------------------------------*/
 
-#define REMOVED ((struct clause *) ((uintptr_t) 1))
-#define VALID(C) ((C) && (C) != REMOVED)
-
-/*------------------------------------------------------------------------*/
-
 // Global command line run-time options.
 
 static int verbosity;     // -1=quiet, 0=default, 1=verbose, INT_MAX=logging
 static int mode = strict; // Default 'strict not 'relaxed' nor 'pedantic'.
 static bool no_reuse;     // Do not allow to reuse clause IDs.
+static bool follow;       // Wait for more data at end-of-file.
+static unsigned threads;  // Number of lemma checking worker threads.
+static bool backward;     // Only check lemmas needed for cores.
+static bool propagate;    // Propagate if antecedents are incomplete.
+static bool idrup;        // Non-linear IDRUP proof without identifiers.
 
 /*------------------------------------------------------------------------*/
 
@@ -167,7 +292,7 @@ static bool no_reuse;     // Do not allow to reuse clause IDs.
 // Array of two files statically allocated and initialized.
 
 static int num_files;
-static struct file files[2] = {{.lineno = 1}, {.lineno = 1}};
+static struct file files[2];
 
 // The actual interaction and proof files point into this array.
 
@@ -209,31 +334,64 @@ static const char *const SATISFIABLE = "SATISFIABLE";
 static const char *const UNSATISFIABLE = "UNSATISFIABLE";
 static const char *const UNKNOWN = "UNKNOWN";
 static const char *const LIDRUP = "lidrup";
+static const char *const IDRUP = "idrup";
 static const char *const ICNF = "icnf";
 
 // The parser saves strings here.
 
 static const char *string;
 
+// Header lines can optionally give size hints, i.e., the maximum variable
+// index, the expected number of clauses and the maximum clause identifier
+// as in 'p lidrup 1000 50000 80000', which are used to allocate the
+// corresponding tables once up-front (see 'presize').
+
+enum { VARIABLES_HINT, CLAUSES_HINT, IDENTIFIERS_HINT, HINTS };
+
+static const char *const hint_names[HINTS] = {"variables", "clauses",
+                                              "identifiers"};
+static int64_t hints[HINTS];
+
+#define MAX_HINT ((int64_t) 1 << 48)
+
+// Hints are only used to speed up allocation and thus wrong hints should
+// never make checking fail.  Hints which are too large are ignored.
+
+static void ignore_invalid_hints (void) {
+  for (unsigned i = 0; i != HINTS; i++)
+    if (hints[i] > MAX_HINT)
+      hints[i] = 0;
+  if (hints[VARIABLES_HINT] >= INT_MAX)
+    hints[VARIABLES_HINT] = 0;
+}
+
 /*------------------------------------------------------------------------*/
 
 // Checker state.
 
-static int max_var;                // Maximum variable index imported.
-static size_t allocated;           // Allocated variables (>= 'max_var').
-static bool *imported;             // Variable index imported?
-static struct hash_table active;   // Active clauses (map ID to clause).
-static struct hash_table inactive; // Inactive clauses (map ID to clause).
-static struct bit_table used;      // Used clause identifiers.
-static signed char *values;        // Assignment of literal: -1, 0, or 1.
-static bool *marks;                // Marks of literals.
+static int max_var;                    // Maximum variable index imported.
+static size_t allocated;               // Allocated variables >= 'max_var'.
+static bool *imported;                 // Variable index imported?
+static struct hash_table clause_index; // All clauses by identifier.
+static struct epochs epochs;           // Epochs of weakened clauses.
+static bool epoch_closed;              // Start new weakening epoch.
+static struct bit_table used;          // Used clause identifiers.
+static bool *marks;                    // Marks of literals.
+static struct positions *watches;      // Watchers of literals.
+
+// The assignment of literals to -1, 0, or 1 (indexed by literal).
+
+static _Thread_local signed char *values;
 
 // This is the default preallocated trail. It is only resized during
 // importing a new variable and thus allows simpler 'push' operations,
 // without the need to check for the need for resizing when traversing
-// either, which gives an nicer code when propagating literals.
+// either, which gives an nicer code when propagating literals.  As the
+// values it is thread local, since worker threads checking lemmas in
+// parallel (see '--threads') have their own assignment and trail.  The
+// literals below 'root' are assigned on the root level (see 'root').
 
-static struct { int *begin, *end; } trail;
+static _Thread_local struct { int *begin, *root, *end; } trail;
 
 // Maps decision level to trail heights.
 
@@ -244,37 +402,71 @@ static bool inconsistent; // Empty clause derived.
 
 static struct clauses input_clauses;
 
+// Antecedent clauses of the current line found before resolving them.
+
+static struct clauses antecedents;
+
+// Clause arenas and free lists of recycled clauses.
+
+#define arena_size ((size_t) 1 << 22) // 4 MB
+#define clause_alignment 8
+#define max_arena_clause_bytes 1024
+#define size_classes (max_arena_clause_bytes / clause_alignment + 1)
+
+static struct {
+  struct block *arenas;  // All arenas (last allocated first).
+  struct block *large;   // Blocks with one large clause each.
+  char *top, *end;       // Bump allocation in last allocated arena.
+  size_t bumped;         // Bytes bump allocated in arenas.
+  size_t live;           // Bytes of allocated clauses in arenas.
+  struct free_clause *free[size_classes]; // Free lists of size classes.
+} clause_store;
+
 /*------------------------------------------------------------------------*/
 
 // Global statistics
 
 static struct {
   size_t added;
+  size_t bulk_restored;
+  size_t chained;
   size_t checks;
+  size_t cleared;
+  size_t compactions;
   size_t conclusions;
   size_t cores;
   size_t deleted;
   size_t inputs;
   size_t imported;
+  size_t inlined;
   size_t lemmas;
   size_t models;
+  size_t propagated;
+  size_t propagations;
+  size_t rebuilds;
   size_t resolutions;
   size_t queries;
+  size_t recycled;
+  size_t resets;
   size_t restored;
+  size_t skipped;
+  size_t units;
   size_t weakened;
 } statistics;
 
 /*------------------------------------------------------------------------*/
 
-// Buffers for printing literals when logging ('debug_literal').
+// Buffers for printing literals when logging ('debug_literal').  These are
+// thread local as worker threads assign literals too (see '--threads').
 
 #ifndef NDEBUG
 
 #define capacity_debug_buffer 2
 #define debug_buffer_line_size 64
 
-static char debug_buffer[capacity_debug_buffer][debug_buffer_line_size];
-static size_t next_debug_buffer_position;
+static _Thread_local char debug_buffer[capacity_debug_buffer]
+                                      [debug_buffer_line_size];
+static _Thread_local size_t next_debug_buffer_position;
 
 #endif
 
@@ -357,17 +549,97 @@ static size_t next_debug_buffer_position;
 
 /*------------------------------------------------------------------------*/
 
-// Iterator for the literals of a clause.
+// Literals of clauses are stored with the smallest width (in bytes) which
+// can hold all literals of the clause, i.e., as 'int8_t' if all variables
+// are smaller than 128, as 'int16_t' if smaller than 32768 and as 'int'
+// otherwise.  Hot loops dispatch on the width once and then iterate with
+// 'all_literals_of_width' over literals of the given type.  Otherwise
+// 'get_literal' decodes literals one by one.
 
-#define begin_literals(C) ((C)->lits)
+#define begin_literals_of_width(TYPE, C) ((TYPE *) (C)->lits)
 
-#define end_literals(C) (begin_literals (C) + (C)->size)
+#define end_literals_of_width(TYPE, C) \
+  (begin_literals_of_width (TYPE, C) + (C)->size)
 
-#define all_literals(LIT, C) \
-  int LIT, *P_##LIT = begin_literals (C), *END_##LIT = end_literals (C); \
+#define all_literals_of_width(TYPE, LIT, C) \
+  TYPE LIT, *P_##LIT = begin_literals_of_width (TYPE, C), \
+            *END_##LIT = end_literals_of_width (TYPE, C); \
   P_##LIT != END_##LIT && (LIT = *P_##LIT, true); \
   P_##LIT++
 
+static int get_literal (const struct clause *c, unsigned i) {
+  assert (i < c->size);
+  switch (c->width) {
+  case 1:
+    return ((const int8_t *) c->lits)[i];
+  case 2:
+    return ((const int16_t *) c->lits)[i];
+  default:
+    assert (c->width == 4);
+    return c->lits[i];
+  }
+}
+
+/*------------------------------------------------------------------------*/
+
+// Most lemmas are short.  Instead of allocating a 'struct clause' for unit
+// and binary lemmas their literals are stored directly in the clause slot
+// of the clause index as a tagged pointer with the least significant bit
+// set (actual clauses are aligned).  Both literals are encoded in 31 bits
+// each as twice the variable plus the sign bit, where zero denotes a
+// missing second literal.  This requires 64-bit pointers and variables
+// smaller than 'max_inlined_variable'.  Input clauses are not inlined
+// since they need to be kept for checking models.  Tautological clauses
+// are not inlined either.  Inlined clauses have no room for flags and
+// thus are turned into actual clauses if they are weakened (see
+// 'find_then_weaken_clause').  Inlined clauses can only be distinguished
+// from actual clauses by 'inlined' and thus need to be checked for before
+// accessing any field of a clause found in the clause index.
+
+#if UINTPTR_MAX > 0xffffffff
+#define max_inlined_variable ((1 << 30) - 1)
+#else
+#define max_inlined_variable 0
+#endif
+
+static bool inlined (struct clause *c) { return (uintptr_t) c & 1; }
+
+static uint64_t encode_inlined_literal (int lit) {
+  assert (lit && lit != INT_MIN && abs (lit) <= max_inlined_variable);
+  return 2 * (uint64_t) abs (lit) + (lit < 0);
+}
+
+static int decode_inlined_literal (uint64_t code) {
+  int idx = code >> 1;
+  return (code & 1) ? -idx : idx;
+}
+
+static struct clause *inline_clause (size_t size, const int *lits) {
+  assert (size == 1 || size == 2);
+  uint64_t code = 1 | encode_inlined_literal (lits[0]) << 1;
+  if (size == 2)
+    code |= encode_inlined_literal (lits[1]) << 32;
+  return (struct clause *) (uintptr_t) code;
+}
+
+// Decodes the literals of an inlined clause into 'lits' and returns their
+// number, which is either one or two.
+
+static unsigned inlined_literals (struct clause *c, int *lits) {
+  assert (inlined (c));
+  const uint64_t code = (uintptr_t) c;
+  lits[0] = decode_inlined_literal ((code >> 1) & 0x7fffffff);
+  const uint64_t second = code >> 32;
+  if (!second)
+    return 1;
+  lits[1] = decode_inlined_literal (second);
+  return 2;
+}
+
+static bool clause_weakened (struct clause *c) {
+  return !inlined (c) && c->weakened;
+}
+
 /*------------------------------------------------------------------------*/
 
 // Function to print messages and errors with nice formatting prototypes to
@@ -444,11 +716,33 @@ static void verbose (const char *fmt, ...) {
 static void parse_error (const char *, ...)
     __attribute__ ((format (printf, 1, 2)));
 
+static void report_failed_queued_lemma (void);
+
+// In order to keep the parser fast we do not count columns and bytes
+// while parsing but only keep track of the position of the current line
+// in the file and then compute the column on demand ('parse_error').  The
+// position is the offset of the current buffer in the file plus the
+// position in the buffer.  Carriage returns are not counted as bytes.
+
+static size_t position (struct file *f) {
+  return f->offset + f->size_buffer;
+}
+
+static size_t bytes_parsed (struct file *f) {
+  return position (f) - f->returns;
+}
+
+static size_t column (struct file *f) {
+  size_t line_bytes = position (f) - f->line_position;
+  return line_bytes - (f->returns - f->line_returns);
+}
+
 static void parse_error (const char *fmt, ...) {
   assert (file);
+  report_failed_queued_lemma ();
   fprintf (stderr,
            "lidrup-check: parse error: at line %zu column %zu in '%s': ",
-           file->start_of_line, file->colno, file->name);
+           file->start_of_line, column (file), file->name);
   va_list ap;
   va_start (ap, fmt);
   vfprintf (stderr, fmt, ap);
@@ -462,6 +756,7 @@ static void check_error (const char *, ...)
 
 static void check_error (const char *fmt, ...) {
   assert (file);
+  report_failed_queued_lemma ();
   fprintf (stderr, "lidrup-check: error: at line %zu in '%s': ",
            file->start_of_line, file->name);
   va_list ap;
@@ -472,15 +767,23 @@ static void check_error (const char *fmt, ...) {
   exit (1);
 }
 
-static bool type_has_id (int t) { return t == 'i' || t == 'l'; }
+// In non-linear IDRUP proofs lines have neither clause identifiers nor
+// antecedents and deleted, weakened and restored clauses are given by
+// their literals instead.
+
+static bool type_has_id (int t) {
+  return !idrup && (t == 'i' || t == 'l');
+}
 
 static bool type_has_lits (int t) {
   return t == 'i' || t == 'l' || t == 'q' || t == 'm' || t == 'u' ||
-         t == 'v' || t == 'f';
+         t == 'v' || t == 'f' ||
+         (idrup && (t == 'd' || t == 'w' || t == 'r'));
 }
 
 static bool type_has_ids (int t) {
-  return t == 'l' || t == 'd' || t == 'w' || t == 'r' || t == 'u';
+  return !idrup &&
+         (t == 'l' || t == 'd' || t == 'w' || t == 'r' || t == 'u');
 }
 
 static void line_error (int type, const char *, ...)
@@ -490,6 +793,7 @@ static void line_error (int type, const char *fmt, ...) {
   assert (type != 's');
   assert (type != 'p');
   assert (file);
+  report_failed_queued_lemma ();
   fflush (stdout);
   fprintf (stderr, "lidrup-check: error: at line %zu in '%s': ",
            file->start_of_line, file->name);
@@ -593,6 +897,16 @@ static void debug_clause (struct clause *c, const char *fmt, ...) {
   va_start (ap, fmt);
   vprintf (fmt, ap);
   va_end (ap);
+  if (inlined (c)) {
+    int lits[2];
+    unsigned size = inlined_literals (c, lits);
+    printf (" inlined lemma size %u clause", size);
+    for (unsigned i = 0; i != size; i++)
+      printf (" %s", debug_literal (lits[i]));
+    fputc ('\n', stdout);
+    fflush (stdout);
+    return;
+  }
   if (c->tautological)
     fputs (" tautological", stdout);
   if (c->weakened)
@@ -603,8 +917,8 @@ static void debug_clause (struct clause *c, const char *fmt, ...) {
     fputs (" lemma", stdout);
   printf (" size %u line %zu clause[%" PRId64 "]", c->size, c->lineno,
           c->id);
-  for (all_literals (lit, c))
-    printf (" %s", debug_literal (lit));
+  for (unsigned i = 0; i != c->size; i++)
+    printf (" %s", debug_literal (get_literal (c, i)));
   fputc ('\n', stdout);
   fflush (stdout);
 }
@@ -707,13 +1021,29 @@ static void increase_allocated (int idx) {
     free (imported);
     imported = new_imported;
   }
+  if (propagate) {
+    struct positions *new_watches =
+        calloc (2 * new_allocated, sizeof *new_watches);
+    if (!new_watches)
+      out_of_memory ("reallocating watches of size %zu", new_allocated);
+    new_watches += new_allocated;
+    if (max_var)
+      for (int lit = -max_var; lit <= max_var; lit++)
+        new_watches[lit] = watches[lit];
+    if (watches) {
+      watches -= allocated;
+      free (watches);
+    }
+    watches = new_watches;
+  }
   {
-    assert (EMPTY (trail));
+    assert (trail.end == trail.root);
+    const size_t root_level = trail.root - trail.begin;
     trail.begin =
         realloc (trail.begin, new_allocated * sizeof *trail.begin);
     if (!trail.begin)
       out_of_memory ("reallocating trail of size %zu", new_allocated);
-    trail.end = trail.begin;
+    trail.root = trail.end = trail.begin + root_level;
   }
   allocated = new_allocated;
 }
@@ -757,49 +1087,788 @@ static inline void set_file (struct file *new_file) {
     assert (!other_file);
 }
 
+// Proofs can be huge (hundreds of gigabytes) and thus for regular files
+// we avoid copying every byte into a buffer and instead map the file in
+// windows of 'mapped_window_size' bytes into memory.  The parser walks
+// these windows directly and a window is unmapped as soon as it is
+// completely consumed.  Before walking a window we ask the kernel to
+// fetch the following window, such that I/O overlaps with checking.
+
+// Pipes and other non-regular files as well as files which fail to be
+// mapped fall back to reading with 'read' into chunks.  This is done by
+// a separate reader thread which stays up to 'read_ahead_chunks' ahead
+// of the parser, which in turn only blocks if it catches up.
+
+// Both files can also be pipes written concurrently by the SAT solver
+// (standard input given as '-' or named pipes), so that checking runs in
+// parallel to solving.  Then the solver might fill one pipe while the
+// checker waits for lines on the other pipe, which would deadlock if the
+// reader thread stopped reading ahead.  Therefore in this situation the
+// reader threads read ahead without limit.  Named pipes are opened
+// without blocking as the solver might open them in any order and the
+// reader thread only switches to blocking reads after the first writer
+// showed up.  Chunks of pipes have the size of the pipe buffer, which we
+// try to enlarge to 'read_chunk_size' bytes first.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define mapped_window_size ((size_t) 1 << 26) // 64 MB
+#define read_chunk_size ((size_t) 1 << 20)  // 1 MB
+#define read_ahead_chunks 4
+
+static void wait_for_writer (int fd) {
+  int flags = fcntl (fd, F_GETFL);
+  if (flags < 0 || !(flags & O_NONBLOCK))
+    return;
+  struct pollfd p = {.fd = fd, .events = POLLIN};
+  (void) pthread_setcancelstate (PTHREAD_CANCEL_ENABLE, 0);
+  while (poll (&p, 1, -1) < 0 && errno == EINTR)
+    ;
+  (void) pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, 0);
+  (void) fcntl (fd, F_SETFL, flags & ~O_NONBLOCK);
+}
+
+// In '--follow' mode a regular file is read like 'tail -f' does, i.e.,
+// the reader thread waits at end-of-file for the file to grow.  The file
+// is complete if nobody has it open for writing anymore, which we check
+// by trying to get a read lease (only fails with 'EAGAIN' if there is a
+// writer).  An 'IN_CLOSE_WRITE' event from 'inotify' ends following too.
+// After the writer is known to have closed the file we still read until
+// 'read' returns zero, as data might have been appended after the last
+// end-of-file.  Neither format has a terminating line, thus closing the
+// file is the only way to tell that the proof is complete.
+//
+// Without leases (e.g., the file is owned by another user) the writer
+// might have closed the file before we started watching it and then no
+// 'IN_CLOSE_WRITE' event will ever arrive.  In this case only, following
+// stops after the size of the file (checked with 'fstat') did not change
+// for '--follow-timeout' seconds (zero means waiting forever).  Waiting
+// for more data uses 'inotify' if available and otherwise polling.
+//
+// While we briefly hold the probing lease, a process opening the file
+// for writing (e.g., appending with '>>') makes the kernel break the
+// lease by sending 'SIGIO' to us, which by default terminates the
+// process.  Therefore 'SIGIO' is ignored while following.
+
+#include <sys/inotify.h>
+#include <time.h>
+
+#define follow_poll_interval 100   // Milliseconds.
+#define max_follow_timeout 1000000 // Seconds.
+
+static unsigned follow_timeout = 60; // Seconds (only without leases).
+
+static void init_follow (struct file *f) {
+  struct reader *r = f->reader;
+  r->follow = true;
+  r->size = -1;
+  (void) signal (SIGIO, SIG_IGN);
+  r->inotify = inotify_init1 (IN_CLOEXEC);
+  if (r->inotify >= 0 &&
+      inotify_add_watch (r->inotify, f->name, IN_MODIFY | IN_CLOSE_WRITE) <
+          0) {
+    close (r->inotify);
+    r->inotify = -1;
+  }
+  if (r->inotify >= 0)
+    verbose ("following '%s' with 'inotify'", f->name);
+  else
+    verbose ("following '%s' by polling every %d ms", f->name,
+             follow_poll_interval);
+}
+
+static bool writer_closed (struct reader *r, int fd) {
+  if (r->writer_closed)
+    return true;
+  if (r->no_lease)
+    return false;
+  if (fcntl (fd, F_SETLEASE, F_RDLCK)) {
+    if (errno != EAGAIN)
+      r->no_lease = true;
+    return false;
+  }
+  (void) fcntl (fd, F_SETLEASE, F_UNLCK);
+  r->writer_closed = true;
+  return true;
+}
+
+static double follow_time (void) {
+  struct timespec ts;
+  (void) clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+// Returns 'false' if following should stop, i.e., without leases after
+// the file did not grow for 'follow_timeout' seconds.
+
+static bool wait_for_more (struct reader *r, int fd) {
+  if (r->no_lease && follow_timeout) {
+    struct stat buf;
+    double now = follow_time ();
+    if (!fstat (fd, &buf) && buf.st_size != r->size)
+      r->size = buf.st_size, r->unchanged = now;
+    else if (now - r->unchanged >= follow_timeout)
+      return false;
+  }
+  if (r->inotify >= 0) {
+    struct pollfd p = {.fd = r->inotify, .events = POLLIN};
+    if (poll (&p, 1, follow_poll_interval) <= 0)
+      return true;
+    char buffer[4096]
+        __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+    ssize_t bytes = read (r->inotify, buffer, sizeof buffer);
+    for (const char *p = buffer; p < buffer + bytes;) {
+      const struct inotify_event *event = (void *) p;
+      if (event->mask & IN_CLOSE_WRITE)
+        r->writer_closed = true;
+      p += sizeof *event + event->len;
+    }
+    return true;
+  }
+  struct timespec ts = {0, follow_poll_interval * 1000000L};
+  while (nanosleep (&ts, &ts) && errno == EINTR)
+    ;
+  return true;
+}
+
+static void *read_ahead (void *ptr) {
+  struct file *f = ptr;
+  struct reader *r = f->reader;
+  int fd = fileno (f->file);
+  (void) pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, 0);
+  wait_for_writer (fd);
+  for (;;) {
+    pthread_mutex_lock (&r->mutex);
+    while (!r->closing && !r->unbounded &&
+           r->queued >= read_ahead_chunks)
+      pthread_cond_wait (&r->consumed, &r->mutex);
+    if (r->closing) {
+      pthread_mutex_unlock (&r->mutex);
+      break;
+    }
+    struct chunk *c = r->free;
+    if (c)
+      r->free = c->next;
+    r->reading = c;
+    pthread_mutex_unlock (&r->mutex);
+    if (!c) {
+      if (!(c = malloc (sizeof *c + r->chunk_size))) {
+        pthread_mutex_lock (&r->mutex);
+        r->error = ENOMEM;
+        r->end_of_file = true;
+        pthread_cond_signal (&r->filled);
+        pthread_mutex_unlock (&r->mutex);
+        break;
+      }
+      r->reading = c;
+    }
+    (void) pthread_setcancelstate (PTHREAD_CANCEL_ENABLE, 0);
+    ssize_t bytes;
+    while (!(bytes = read (fd, c->chars, r->chunk_size)) && r->follow &&
+           !r->writer_closed)
+      if (!writer_closed (r, fd) && !wait_for_more (r, fd))
+        break;
+    int error = errno;
+    (void) pthread_setcancelstate (PTHREAD_CANCEL_DISABLE, 0);
+    pthread_mutex_lock (&r->mutex);
+    r->reading = 0;
+    if (bytes <= 0) {
+      c->next = r->free;
+      r->free = c;
+      if (bytes < 0)
+        r->error = error;
+      r->end_of_file = true;
+    } else {
+      c->size = bytes;
+      c->next = 0;
+      if (r->last)
+        r->last->next = c;
+      else
+        r->first = c;
+      r->last = c;
+      r->queued++;
+    }
+    pthread_cond_signal (&r->filled);
+    pthread_mutex_unlock (&r->mutex);
+    if (bytes <= 0)
+      break;
+  }
+  return 0;
+}
+
+static void start_reader (struct file *f) {
+  assert (!f->reader);
+  struct reader *r = calloc (1, sizeof *r);
+  if (!r)
+    out_of_memory ("allocating reader for '%s'", f->name);
+  r->chunk_size = read_chunk_size;
+  struct stat buf;
+  int fd = fileno (f->file);
+  if (fstat (fd, &buf))
+    buf.st_mode = 0;
+  if (S_ISFIFO (buf.st_mode)) {
+    (void) fcntl (fd, F_SETPIPE_SZ, (int) read_chunk_size);
+    int size = fcntl (fd, F_GETPIPE_SZ);
+    if (size > 0 && (size_t) size < read_chunk_size)
+      r->chunk_size = size;
+    r->unbounded = num_files == 2 && !f->decompressor;
+    verbose ("reading pipe '%s' in chunks of %zu bytes%s", f->name,
+             r->chunk_size, r->unbounded ? " without limit" : "");
+  }
+  pthread_mutex_init (&r->mutex, 0);
+  pthread_cond_init (&r->filled, 0);
+  pthread_cond_init (&r->consumed, 0);
+  f->reader = r;
+  r->inotify = -1;
+  if (follow && S_ISREG (buf.st_mode))
+    init_follow (f);
+  if (pthread_create (&r->thread, 0, read_ahead, f))
+    die ("could not start reader thread for '%s'", f->name);
+}
+
+static void free_chunks (struct chunk *c) {
+  for (struct chunk *next; c; c = next)
+    next = c->next, free (c);
+}
+
+static void stop_reader (struct file *f) {
+  struct reader *r = f->reader;
+  assert (r);
+  pthread_mutex_lock (&r->mutex);
+  r->closing = true;
+  pthread_cond_signal (&r->consumed);
+  pthread_mutex_unlock (&r->mutex);
+  (void) pthread_cancel (r->thread); // Might be blocked in 'read'.
+  pthread_join (r->thread, 0);
+  free_chunks (r->first);
+  free_chunks (r->free);
+  free (r->current);
+  free (r->reading);
+  if (r->inotify >= 0)
+    close (r->inotify);
+  pthread_mutex_destroy (&r->mutex);
+  pthread_cond_destroy (&r->filled);
+  pthread_cond_destroy (&r->consumed);
+  free (r);
+  f->reader = 0;
+}
+
+static bool next_chunk (struct file *f) {
+  struct reader *r = f->reader;
+  assert (r);
+  pthread_mutex_lock (&r->mutex);
+  struct chunk *c = r->current;
+  if (c) {
+    c->next = r->free;
+    r->free = c;
+    r->current = 0;
+  }
+  while (!r->first && !r->end_of_file)
+    pthread_cond_wait (&r->filled, &r->mutex);
+  c = r->first;
+  if (c) {
+    if (!(r->first = c->next))
+      r->last = 0;
+    assert (r->queued);
+    r->queued--;
+    r->current = c;
+    pthread_cond_signal (&r->consumed);
+  }
+  int error = r->error;
+  pthread_mutex_unlock (&r->mutex);
+  if (!c) {
+    if (error)
+      die ("reading from '%s' failed: %s", f->name, strerror (error));
+    return false;
+  }
+  f->chars = c->chars;
+  f->end_buffer = c->size;
+  f->size_buffer = 0;
+  return true;
+}
+
+static void init_reading (struct file *f) {
+  assert (f->file);
+  struct stat buf;
+  int fd = fileno (f->file);
+  if (!fstat (fd, &buf) && S_ISREG (buf.st_mode) && buf.st_size > 0 &&
+      (uintmax_t) buf.st_size <= SIZE_MAX && !lseek (fd, 0, SEEK_CUR) &&
+      !follow) {
+    assert (!(mapped_window_size % sysconf (_SC_PAGESIZE)));
+    (void) posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    f->file_size = buf.st_size;
+    f->mapped = true;
+  } else
+    start_reader (f);
+}
+
+static void unmap_window (struct file *f) {
+  assert (f->mapped);
+  if (!f->chars)
+    return;
+  (void) munmap (f->chars, f->end_buffer);
+  f->chars = 0;
+  f->end_buffer = f->size_buffer = 0;
+}
+
+static bool map_next_window (struct file *f) {
+  unmap_window (f);
+  size_t offset = f->mapped_bytes;
+  assert (offset <= f->file_size);
+  if (offset == f->file_size)
+    return false;
+  size_t bytes = f->file_size - offset;
+  if (bytes > mapped_window_size)
+    bytes = mapped_window_size;
+  int fd = fileno (f->file);
+  void *window = mmap (0, bytes, PROT_READ, MAP_PRIVATE, fd, offset);
+  if (window == MAP_FAILED) {
+    verbose ("mapping '%s' failed at offset %zu (falling back to 'read')",
+             f->name, offset);
+    if (lseek (fd, offset, SEEK_SET) == (off_t) -1)
+      die ("can not seek to offset %zu in '%s'", offset, f->name);
+    f->mapped = false;
+    start_reader (f);
+    return false;
+  }
+  (void) madvise (window, bytes, MADV_SEQUENTIAL);
+  if (offset + bytes < f->file_size)
+    (void) posix_fadvise (fd, offset + bytes, mapped_window_size,
+                          POSIX_FADV_WILLNEED);
+  f->chars = window;
+  f->mapped_bytes = offset + bytes;
+  f->end_buffer = bytes;
+  f->size_buffer = 0;
+  return true;
+}
+
+// Compressed files are detected by their magic number and decompressed
+// by an external process writing to a pipe, which in turn is read by the
+// reader thread.  Thus decompression does not happen on the checking
+// thread and overlaps with both reading and checking.
+
+static struct {
+  const char *command;  // For messages.
+  const char *argv[5];  // Path to compressed file appended.
+  size_t size;
+  unsigned char magic[6];
+} decompressors[] = {
+    {"bzip2 -c -d", {"bzip2", "-c", "-d"}, 3, {'B', 'Z', 'h'}},
+    {"gzip -c -d", {"gzip", "-c", "-d"}, 2, {0x1f, 0x8b}},
+    {"xz -c -d -T0", {"xz", "-c", "-d", "-T0"}, 6,
+     {0xfd, '7', 'z', 'X', 'Z', 0}},
+    {"zstd -q -c -d", {"zstd", "-q", "-c", "-d"}, 4,
+     {0x28, 0xb5, 0x2f, 0xfd}},
+};
+
+static const size_t num_decompressors =
+    sizeof decompressors / sizeof *decompressors;
+
+static size_t find_decompressor (const char *path) {
+  struct stat buf;
+  if (stat (path, &buf) || !S_ISREG (buf.st_mode))
+    return num_decompressors;
+  FILE *f = fopen (path, "r");
+  if (!f)
+    return num_decompressors;
+  unsigned char magic[sizeof decompressors->magic];
+  size_t size = fread (magic, 1, sizeof magic, f);
+  fclose (f);
+  for (size_t i = 0; i != num_decompressors; i++)
+    if (size >= decompressors[i].size &&
+        !memcmp (magic, decompressors[i].magic, decompressors[i].size))
+      return i;
+  return num_decompressors;
+}
+
+// The decompressor is started directly (and not through the shell as
+// with 'popen') with the path of the file as separate argument.  Thus
+// arbitrary characters in file names (like quotes) are harmless.
+
+static bool start_decompressor (struct file *f, size_t i) {
+  const char *argv[sizeof decompressors->argv / sizeof (char *) + 2];
+  size_t argc = 0;
+  for (const char *const *p = decompressors[i].argv; *p; p++)
+    argv[argc++] = *p;
+  argv[argc++] = f->name;
+  argv[argc] = 0;
+  int fds[2];
+  if (pipe2 (fds, O_CLOEXEC))
+    return false;
+  posix_spawn_file_actions_t actions;
+  bool res = false;
+  if (!posix_spawn_file_actions_init (&actions)) {
+    if (!posix_spawn_file_actions_adddup2 (&actions, fds[1], 1) &&
+        !posix_spawnp (&f->pid, argv[0], &actions, 0, (char **) argv,
+                       environ))
+      res = true;
+    posix_spawn_file_actions_destroy (&actions);
+  }
+  close (fds[1]);
+  if (res && !(f->file = fdopen (fds[0], "r"))) {
+    kill (f->pid, SIGTERM);
+    (void) waitpid (f->pid, 0, 0);
+    res = false;
+  }
+  if (!res)
+    close (fds[0]);
+  else
+    f->decompressor = decompressors[i].command;
+  return res;
+}
+
+static bool open_file (struct file *f) {
+  if (!strcmp (f->name, "-")) {
+    f->name = "<stdin>";
+    f->file = stdin;
+    init_reading (f);
+    return true;
+  }
+  struct stat buf;
+  if (!stat (f->name, &buf) && S_ISFIFO (buf.st_mode)) {
+    int fd = open (f->name, O_RDONLY | O_NONBLOCK);
+    if (fd < 0)
+      return false;
+    if (!(f->file = fdopen (fd, "r"))) {
+      close (fd);
+      return false;
+    }
+    init_reading (f);
+    return true;
+  }
+  size_t decompressor = find_decompressor (f->name);
+  if (decompressor != num_decompressors) {
+    if (follow)
+      die ("can not follow compressed file '%s'", f->name);
+    if (!start_decompressor (f, decompressor))
+      return false;
+  } else if (!(f->file = fopen (f->name, "r")))
+    return false;
+  init_reading (f);
+  return true;
+}
+
+// The exit code of the decompression process is only available after
+// closing the pipe, which we do as soon end-of-file is reached in order
+// to report failed decompression (e.g., for truncated files) before
+// reporting a successful check.
+
+static int wait_for_decompressor (struct file *f) {
+  assert (f->decompressor);
+  fclose (f->file);
+  int status;
+  while (waitpid (f->pid, &status, 0) < 0)
+    if (errno != EINTR)
+      return -1;
+  return status;
+}
+
+static void close_decompressor (struct file *f) {
+  assert (f->decompressor);
+  assert (!f->closed);
+  if (f->reader)
+    stop_reader (f);
+  int status = wait_for_decompressor (f);
+  f->closed = true;
+  if (status)
+    die ("decompressing '%s' with '%s' failed", f->name, f->decompressor);
+}
+
+static bool refill_buffer (struct file *f) {
+  assert (f->size_buffer == f->end_buffer);
+  f->offset += f->end_buffer;
+  if (f->mapped) {
+    if (map_next_window (f))
+      return true;
+    if (f->mapped)
+      return false; // Reached end of mapped file.
+  }
+  if (next_chunk (f))
+    return true;
+  f->end_buffer = f->size_buffer = 0;
+  if (f->decompressor)
+    close_decompressor (f);
+  return false;
+}
+
+static void close_file (struct file *f) {
+  if (f->mapped)
+    unmap_window (f);
+  if (f->reader)
+    stop_reader (f);
+  if (f->closed)
+    return;
+  if (f->decompressor)
+    (void) wait_for_decompressor (f); // Stopped early.
+  else
+    fclose (f->file);
+}
+
 static int read_char (void) {
   assert (file);
   assert (file->file);
   if (file->size_buffer == file->end_buffer) {
     if (file->end_of_file)
       return EOF;
-    file->end_buffer =
-        read (fileno (file->file), file->buffer, sizeof file->buffer);
-    if (!file->end_buffer) {
+    if (!refill_buffer (file)) {
       file->end_of_file = 1;
       return EOF;
     }
-    file->size_buffer = 0;
   }
   assert (file->size_buffer < file->end_buffer);
-  return file->buffer[file->size_buffer++];
+  return (unsigned char) file->chars[file->size_buffer++];
 }
 
 static int next_char (void) {
   int res = read_char ();
   if (res == '\r') {
+    file->returns++;
     res = read_char ();
-    if (res != '\n')
+    if (res != '\n') {
+      if (res != EOF)
+        file->size_buffer--; // Report column of carriage return.
       parse_error ("expected new-line after carriage return");
-  }
-  if (file->last_char == '\n')
-    file->lineno++;
-  file->last_char = res;
-  if (res != EOF) {
-    file->charno++;
-    file->colno++;
+    }
   }
   return res;
 }
 
 static int ISDIGIT (int ch) { return '0' <= ch && ch <= '9'; }
 
+// Most of the time of parsing is spent on the digits of literals and
+// clause identifiers.  After the first digit of a number has been read
+// through 'next_char' this function tries to parse the remaining digits
+// directly from the current buffer window, without per character
+// bookkeeping.  On x86 the end of the digit run is determined with SSE2
+// for 16 characters at once.  This fast path only applies if the digit
+// run ends within the window and has at most 'max_digits' further
+// digits, which rules out overflow.  Otherwise nothing is consumed and
+// 'false' is returned and the caller falls back to the slow path, which
+// also produces the proper error messages.
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static bool parse_remaining_digits_fast (int64_t *res, size_t max_digits) {
+  const char *p = file->chars + file->size_buffer;
+  size_t available = file->end_buffer - file->size_buffer;
+  size_t digits;
+#ifdef __SSE2__
+  if (available >= 16) {
+    const __m128i chars = _mm_loadu_si128 ((const __m128i *) p);
+    const __m128i shifted = _mm_sub_epi8 (chars, _mm_set1_epi8 ('0'));
+    const __m128i clipped = _mm_min_epu8 (shifted, _mm_set1_epi8 (9));
+    const __m128i is_digit = _mm_cmpeq_epi8 (clipped, shifted);
+    unsigned non_digits = ~_mm_movemask_epi8 (is_digit) & 0xffff;
+    if (!non_digits)
+      return false;
+    digits = __builtin_ctz (non_digits);
+  } else
+#endif
+  {
+    digits = 0;
+    while (digits != available && ISDIGIT (p[digits]))
+      digits++;
+    if (digits == available)
+      return false;
+  }
+  if (digits > max_digits)
+    return false;
+  if (!digits)
+    return true;
+  int64_t tmp = *res;
+  for (size_t i = 0; i != digits; i++)
+    tmp = 10 * tmp + (p[i] - '0');
+  *res = tmp;
+  file->size_buffer += digits;
+  return true;
+}
+
+// Beside the textual format we also support a compact binary format
+// for both interaction and proof files, which is detected by the first
+// byte of the file.  Each binary line starts with the type letter of the
+// line with its most significant bit set (thus never a printable
+// character) followed by unsigned LEB128 encoded numbers (seven bits per
+// byte, least significant first, most significant bit set if more bytes
+// follow).  There are neither comments nor new-lines and line types are
+// always explicit.  Literals are encoded as '2 * idx + sign' and lists of
+// literals are terminated by zero.  Clause identifiers are delta encoded
+// with respect to the previous clause identifier in the file in order to
+// keep numbers small.  The clause identifier of a line is encoded as
+// zig-zag mapped difference 'd', i.e., '2 * d' for 'd >= 0' and
+// '-2 * d - 1' otherwise, and in lists of clause identifiers the zig-zag
+// mapped difference is incremented by one in order to keep zero as list
+// terminator.  The header 'p' line consists of a single 'i' or 'l' byte
+// for 'icnf' and 'lidrup' followed by the optional size hints incremented
+// by one and a terminating zero, while a status line
+// 's' is followed by the status code '10' ('SATISFIABLE'), '20'
+// ('UNSATISFIABLE') or '0' ('UNKNOWN').
+
+#define BINARY_BIT 0x80
+
+static void detect_format (void) {
+  assert (!file->detected);
+  int ch = read_char ();
+  if (ch != EOF) {
+    file->size_buffer--; // Unread first byte.
+    file->binary = (ch & BINARY_BIT);
+  }
+  if (file->binary)
+    verbose ("detected binary format in '%s'", file->name);
+  file->detected = true;
+}
+
+static uint64_t read_binary_number (const char *what) {
+  uint64_t res = 0;
+  for (unsigned shift = 0;; shift += 7) {
+    int ch = read_char ();
+    if (ch == EOF)
+      parse_error ("end-of-file in %s", what);
+    if (shift == 63 && (ch & ~1))
+      parse_error ("%s too large", what);
+    res |= (uint64_t) (ch & 0x7f) << shift;
+    if (!(ch & 0x80))
+      return res;
+  }
+}
+
+static int64_t read_binary_id (uint64_t zig_zag, const char *what) {
+  const uint64_t magnitude = zig_zag >> 1;
+  const uint64_t last = file->last_id;
+  uint64_t res;
+  if (zig_zag & 1) {
+    if (magnitude + 1 >= last - (uint64_t) INT64_MIN)
+      parse_error ("%s too small", what);
+    res = last - magnitude - 1;
+  } else {
+    if (magnitude > (uint64_t) INT64_MAX - last)
+      parse_error ("%s too large", what);
+    res = last + magnitude;
+  }
+  if (!res)
+    parse_error ("zero %s", what);
+  file->last_id = res;
+  return res;
+}
+
+static int next_binary_line_without_printing (void) {
+
+  file->line_position = position (file);
+  file->line_returns = file->returns;
+  file->lineno++;
+  int ch = read_char ();
+  file->start_of_line = file->lineno;
+
+  if (ch == EOF)
+    return 0;
+
+  if (idrup && file == proof)
+    parse_error ("binary format not supported for IDRUP proofs");
+
+  int parsed_type = ch & ~BINARY_BIT;
+  if (!(ch & BINARY_BIT) || !strchr ("acdfilmpqrsuvw", parsed_type))
+    parse_error ("invalid binary line type byte %02x", ch);
+
+  int actual_type = parsed_type == 'a' ? 'q' : parsed_type;
+  string = 0;
+
+  line.id = 0;
+  CLEAR (line.lits);
+  CLEAR (line.ids);
+  file->lines++;
+
+  if (actual_type == 'p') {
+    ch = read_char ();
+    if (ch == 'i')
+      string = ICNF;
+    else if (ch == 'l')
+      string = LIDRUP;
+    else
+      parse_error ("invalid binary 'p' header line");
+    memset (hints, 0, sizeof hints);
+    for (unsigned i = 0;; i++) {
+      uint64_t hint = read_binary_number ("header");
+      if (!hint)
+        break;
+      if (i == HINTS)
+        parse_error ("expected zero after binary '%s' header", string);
+      if (--hint > (uint64_t) MAX_HINT)
+        hint = MAX_HINT + 1;
+      hints[i] = hint;
+    }
+    ignore_invalid_hints ();
+    return 'p';
+  }
+
+  if (actual_type == 's') {
+    uint64_t status = read_binary_number ("status");
+    if (status == 10)
+      string = SATISFIABLE;
+    else if (status == 20)
+      string = UNSATISFIABLE;
+    else if (!status)
+      string = UNKNOWN;
+    else
+      parse_error ("invalid binary status line");
+    return 's';
+  }
+
+  if (file != interactions && type_has_id (actual_type)) {
+    uint64_t zig_zag = read_binary_number ("clause identifier");
+    int64_t id = read_binary_id (zig_zag, "clause identifier");
+    if (id < 0)
+      parse_error ("expected non-negative clause identifier");
+    line.id = id;
+  }
+
+  if (type_has_lits (actual_type)) {
+    for (;;) {
+      uint64_t code = read_binary_number ("literal");
+      if (!code)
+        break;
+      uint64_t idx = code >> 1;
+      if (!idx)
+        parse_error ("invalid binary literal encoding %" PRIu64, code);
+      if (idx > INT_MAX)
+        parse_error ("variable index too large");
+      import_variable (idx);
+      int lit = (code & 1) ? -(int) idx : (int) idx;
+      PUSH (line.lits, lit);
+    }
+  }
+
+  if (file == interactions || !type_has_ids (actual_type))
+    return actual_type;
+
+  for (;;) {
+    uint64_t code = read_binary_number ("antecedent clause identifier");
+    if (!code)
+      return actual_type;
+    int64_t id = read_binary_id (code - 1, "antecedent clause identifier");
+    PUSH (line.ids, id);
+  }
+}
+
 static int next_line_without_printing (char default_type) {
 
+  if (!file->detected)
+    detect_format ();
+  if (file->binary)
+    return next_binary_line_without_printing ();
+
   int ch;
 
   for (;;) {
-    file->colno = 0;
+    file->line_position = position (file);
+    file->line_returns = file->returns;
+    file->lineno++;
     ch = next_char ();
     file->start_of_line = file->lineno;
     if (ch == 'c') {
@@ -848,10 +1917,19 @@ static int next_line_without_printing (char default_type) {
 
     ch = next_char ();
     if (ch == 'i') {
-      for (const char *p = "cnf"; (ch = *p); p++)
-        if (next_char () != ch)
-          goto INVALID_HEADER_LINE;
-      string = ICNF;
+      ch = next_char ();
+      if (ch == 'c') {
+        for (const char *p = "nf"; (ch = *p); p++)
+          if (next_char () != ch)
+            goto INVALID_HEADER_LINE;
+        string = ICNF;
+      } else if (ch == 'd') {
+        for (const char *p = "rup"; (ch = *p); p++)
+          if (next_char () != ch)
+            goto INVALID_HEADER_LINE;
+        string = IDRUP;
+      } else
+        goto INVALID_HEADER_LINE;
     } else if (ch == 'l') {
       for (const char *p = "idrup"; (ch = *p); p++)
         if (next_char () != ch)
@@ -860,11 +1938,27 @@ static int next_line_without_printing (char default_type) {
     } else
       goto INVALID_HEADER_LINE;
 
-    // TODO parse 'p cnf <vars> <clauses>' header too.
+    memset (hints, 0, sizeof hints);
+    ch = next_char ();
+    for (unsigned i = 0; ch == ' ' && i != HINTS; i++) {
+      if (!ISDIGIT (ch = next_char ()))
+        parse_error ("expected %s hint in '%s' header", hint_names[i],
+                     string);
+      int64_t hint = ch - '0';
+      while (ISDIGIT (ch = next_char ())) {
+        if (!hint)
+          parse_error ("invalid leading '0' digit");
+        if (hint <= MAX_HINT)
+          hint = 10 * hint + (ch - '0');
+      }
+      hints[i] = hint;
+    }
 
-    if (next_char () != '\n')
+    if (ch != '\n')
       parse_error ("expected new line after '%s' header", string);
 
+    ignore_invalid_hints ();
+
     return 'p';
   }
 
@@ -934,16 +2028,19 @@ static int next_line_without_printing (char default_type) {
 
     int64_t id = ch - '0';
 
-    while (ISDIGIT (ch = next_char ())) {
-      assert (id);
-      if (INT64_MAX / 10 < id)
-        parse_error ("clause identifier too large");
-      id *= 10;
-      int digit = ch - '0';
-      if (INT64_MAX - digit < id)
-        parse_error ("clause identifier too large");
-      id += digit;
-    }
+    if (parse_remaining_digits_fast (&id, 17))
+      ch = next_char ();
+    else
+      while (ISDIGIT (ch = next_char ())) {
+        assert (id);
+        if (INT64_MAX / 10 < id)
+          parse_error ("clause identifier too large");
+        id *= 10;
+        int digit = ch - '0';
+        if (INT64_MAX - digit < id)
+          parse_error ("clause identifier too large");
+        id += digit;
+      }
 
     if (ch != ' ')
       parse_error ("expected space after '%" PRId64 "'", id);
@@ -975,18 +2072,23 @@ static int next_line_without_printing (char default_type) {
       }
 
       int idx = ch - '0';
+      int64_t fast = idx;
 
-      while (ISDIGIT (ch = next_char ())) {
-        if (!idx)
-          parse_error ("invalid leading '0' digit");
-        if (INT_MAX / 10 < idx)
-          parse_error ("variable index too large");
-        idx *= 10;
-        int digit = ch - '0';
-        if (INT_MAX - digit < idx)
-          parse_error ("variable index too large");
-        idx += digit;
-      }
+      if (idx && parse_remaining_digits_fast (&fast, 8)) {
+        idx = fast;
+        ch = next_char ();
+      } else
+        while (ISDIGIT (ch = next_char ())) {
+          if (!idx)
+            parse_error ("invalid leading '0' digit");
+          if (INT_MAX / 10 < idx)
+            parse_error ("variable index too large");
+          idx *= 10;
+          int digit = ch - '0';
+          if (INT_MAX - digit < idx)
+            parse_error ("variable index too large");
+          idx += digit;
+        }
 
       if (idx)
         import_variable (idx);
@@ -1039,17 +2141,20 @@ static int next_line_without_printing (char default_type) {
 
     int64_t id = ch - '0';
 
-    while (ISDIGIT (ch = next_char ())) {
-      if (!id)
-        parse_error ("invalid leading '0' digit");
-      if (INT64_MAX / 10 < id)
-        parse_error ("antecedent clause identifier too large");
-      id *= 10;
-      int digit = ch - '0';
-      if (INT64_MAX - digit < id)
-        parse_error ("antecedent clause identifier too large");
-      id += digit;
-    }
+    if (id && parse_remaining_digits_fast (&id, 17))
+      ch = next_char ();
+    else
+      while (ISDIGIT (ch = next_char ())) {
+        if (!id)
+          parse_error ("invalid leading '0' digit");
+        if (INT64_MAX / 10 < id)
+          parse_error ("antecedent clause identifier too large");
+        id *= 10;
+        int digit = ch - '0';
+        if (INT64_MAX - digit < id)
+          parse_error ("antecedent clause identifier too large");
+        id += digit;
+      }
 
     if (id) {
 
@@ -1096,14 +2201,154 @@ static void assign (int lit) {
   debug ("assign %s", debug_literal (lit));
 }
 
+static void unassign (int lit) {
+  debug ("unassign %s", debug_literal (lit));
+  assert (values[lit] > 0);
+  assert (values[-lit] < 0);
+  values[lit] = values[-lit] = 0;
+}
+
 static void backtrack (void) {
-  for (all_elements (int, lit, trail)) {
-    debug ("unassign %s", debug_literal (lit));
-    assert (values[lit] > 0);
-    assert (values[-lit] < 0);
-    values[lit] = values[-lit] = 0;
+  for (const int *p = trail.root; p != trail.end; p++)
+    unassign (*p);
+  trail.end = trail.root;
+}
+
+/*------------------------------------------------------------------------*/
+
+// The literals of active unit clauses are assigned persistently on the
+// root level of the trail of the main thread, i.e., below 'trail.root'.
+// Implication checks only backtrack to the root level.  Added and
+// restored unit clauses are assigned right away (unless their literal is
+// already assigned).  Deleting or weakening a unit clause removes it from
+// the root units and triggers a complete reset of the root level before
+// the next check, which reassigns the literals of all remaining root
+// units.  Backward checking ('--backward') can not use root units, since
+// logged lemmas have to be checked without lemmas derived later.
+//
+// Root units must not change which lemmas are accepted, i.e., a root
+// literal may only be used as if it was assigned by the check if the
+// check assigns it anyhow.  Thus root literals are assigned with values
+// '2' and '-2' and a check 'cites' a root literal instead of assigning
+// it, which sets its values to '1' and '-1' until backtracking.  This
+// happens if a cited unit antecedent (or any other antecedent which
+// becomes unit) has a satisfied root literal as unit or if a lemma
+// literal is falsified on the root level.  If instead the check has to
+// assign the negation of a root literal, which was never cited, the root
+// level is cleared and the check restarted without root units (see
+// 'clear_root_level').  The same checks thus succeed and fail as without
+// root units, apart from the propagation fallback of '--propagate'.
+
+struct root_unit {
+  int64_t id;
+  int lit;
+};
+
+struct root_units {
+  struct root_unit *begin, *end, *allocated;
+};
+
+static struct {
+  struct root_units units; // Active unit clauses.
+  struct lits cited;       // Root literals cited by the current check.
+  bool reset;              // Reassign root level before next check.
+  bool conflict;           // Check needs negation of uncited root literal.
+} root;
+
+static bool unit_clause (struct clause *c, int *lit_ptr) {
+  if (inlined (c)) {
+    int lits[2];
+    if (inlined_literals (c, lits) != 1)
+      return false;
+    *lit_ptr = lits[0];
+    return true;
+  }
+  if (c->size != 1)
+    return false;
+  *lit_ptr = get_literal (c, 0);
+  return true;
+}
+
+static void assign_root_unit (int lit) {
+  assert (trail.end == trail.root);
+  if (values[lit])
+    return;
+  debug ("assigning root-level unit %s", debug_literal (lit));
+  assign (lit);
+  values[lit] = 2;
+  values[-lit] = -2;
+  trail.root = trail.end;
+}
+
+static void cite_root_literal (int lit) {
+  assert (values[lit] == 2);
+  assert (values[-lit] == -2);
+  debug ("citing root-level literal %d", lit);
+  values[lit] = 1;
+  values[-lit] = -1;
+  PUSH (root.cited, lit);
+  statistics.units++;
+}
+
+static void uncite_root_literals (void) {
+  for (all_elements (int, lit, root.cited)) {
+    assert (values[lit] == 1);
+    values[lit] = 2;
+    values[-lit] = -2;
   }
-  trail.end = trail.begin;
+  CLEAR (root.cited);
+}
+
+static void add_root_unit (int64_t id, struct clause *c) {
+  int lit;
+  if (backward || !unit_clause (c, &lit))
+    return;
+  struct root_unit unit = {id, lit};
+  PUSH (root.units, unit);
+  if (!root.reset)
+    assign_root_unit (lit);
+}
+
+static void remove_root_unit (int64_t id, struct clause *c) {
+  int lit;
+  if (backward || !unit_clause (c, &lit))
+    return;
+  struct root_unit *p = root.units.end;
+  do
+    assert (p != root.units.begin);
+  while ((--p)->id != id);
+  *p = *--root.units.end;
+  root.reset = true;
+}
+
+static void reset_root_level (void) {
+  if (!root.reset)
+    return;
+  debug ("resetting root level");
+  while (trail.root != trail.begin)
+    unassign (*--trail.root);
+  trail.end = trail.root;
+  root.reset = false;
+  for (all_elements (struct root_unit, unit, root.units))
+    assign_root_unit (unit.lit);
+  statistics.resets++;
+}
+
+// Backtracks the current check and unassigns all root literals, such
+// that the check can be restarted without root units.  The root level is
+// reassigned before the next check.
+
+static void clear_root_level (void) {
+  debug ("clearing root level");
+  assert (root.conflict);
+  root.conflict = false;
+  backtrack ();
+  uncite_root_literals ();
+  while (trail.root != trail.begin)
+    unassign (*--trail.root);
+  trail.end = trail.root;
+  root.reset = true;
+  statistics.cleared++;
 }
 
 /*------------------------------------------------------------------------*/
@@ -1190,37 +2435,199 @@ static bool line_is_tautological () {
   return res;
 }
 
+// Calling 'malloc' and 'free' for every added and deleted clause is costly
+// for proofs with hundreds of millions of lemmas and fragments memory.
+// Instead clauses are allocated by bumping a pointer in large arenas and
+// deleted clauses are kept in free lists, one for each size class of
+// 'clause_alignment' bytes, from which they are recycled.  Only clauses
+// larger than 'max_arena_clause_bytes' get a block of their own.  At the
+// end all memory of clauses is released by freeing blocks.
+
+static size_t clause_bytes (size_t size, unsigned width) {
+  size_t bytes = sizeof (struct clause) + size * width;
+  return (bytes + clause_alignment - 1) & ~(size_t) (clause_alignment - 1);
+}
+
+static struct block *allocate_block (size_t bytes) {
+  struct block *block = malloc (sizeof *block + bytes);
+  if (!block)
+    out_of_memory ("allocating clause block of %zu bytes", bytes);
+  block->prev = 0;
+  block->bytes = bytes;
+  return block;
+}
+
+static void release_blocks (struct block *block) {
+  for (struct block *next; block; block = next)
+    next = block->next, free (block);
+}
+
+static struct block *large_clause_block (struct clause *c) {
+  return (struct block *) ((char *) c - offsetof (struct block, memory));
+}
+
+static struct clause *allocate_clause_memory (size_t size,
+                                             unsigned width) {
+  const size_t bytes = clause_bytes (size, width);
+  if (bytes > max_arena_clause_bytes) {
+    struct block *block = allocate_block (bytes);
+    struct block *next = clause_store.large;
+    if (next)
+      next->prev = block;
+    block->next = next;
+    clause_store.large = block;
+    return (struct clause *) block->memory;
+  }
+  struct free_clause **free_list =
+      clause_store.free + bytes / clause_alignment;
+  struct free_clause *f = *free_list;
+  clause_store.live += bytes;
+  if (f) {
+    *free_list = f->next;
+    statistics.recycled++;
+    return (struct clause *) f;
+  }
+  if ((size_t) (clause_store.end - clause_store.top) < bytes) {
+    struct block *arena = allocate_block (arena_size);
+    debug ("allocated new clause arena at %p", (void *) arena);
+    arena->next = clause_store.arenas;
+    clause_store.arenas = arena;
+    clause_store.top = arena->memory;
+    clause_store.end = arena->memory + arena_size;
+  }
+  struct clause *res = (struct clause *) clause_store.top;
+  clause_store.top += bytes;
+  clause_store.bumped += bytes;
+  return res;
+}
+
+static unsigned literal_width (size_t size, const int *lits) {
+  int max_idx = 0;
+  for (size_t i = 0; i != size; i++) {
+    int idx = abs (lits[i]);
+    if (idx > max_idx)
+      max_idx = idx;
+  }
+  if (max_idx <= INT8_MAX)
+    return 1;
+  if (max_idx <= INT16_MAX)
+    return 2;
+  return 4;
+}
+
+static void store_literals (struct clause *c, const int *lits) {
+  const unsigned size = c->size;
+  switch (c->width) {
+  case 1:
+    for (unsigned i = 0; i != size; i++)
+      ((int8_t *) c->lits)[i] = lits[i];
+    break;
+  case 2:
+    for (unsigned i = 0; i != size; i++)
+      ((int16_t *) c->lits)[i] = lits[i];
+    break;
+  default:
+    assert (c->width == 4);
+    memcpy (c->lits, lits, size * sizeof *lits);
+    break;
+  }
+}
+
 static struct clause *allocate_clause (bool input) {
   size_t size = SIZE (line.lits);
   if (size > UINT_MAX)
     parse_error ("maximum clause size exhausted");
-  size_t lits_bytes = size * sizeof (int);
-  size_t all_bytes = sizeof (struct clause) + lits_bytes;
-  struct clause *c = malloc (all_bytes);
-  if (!c)
-    out_of_memory ("allocating clause of size %zu", size);
-  assert (VALID (c));
+  const unsigned width = literal_width (size, line.lits.begin);
+  struct clause *c = allocate_clause_memory (size, width);
   c->id = line.id;
 #ifndef NDEBUG
   assert (file);
   c->lineno = file->start_of_line;
 #endif
   c->size = size;
+  c->width = width;
   c->weakened = false;
   c->input = input;
   c->tautological = line_is_tautological ();
-  memcpy (c->lits, line.lits.begin, lits_bytes);
+  store_literals (c, line.lits.begin);
   debug_clause (c, "allocate");
-  if (input)
+  if (input) {
+    if (backward && SIZE (input_clauses) > UINT_MAX)
+      parse_error ("maximum number of input clauses exhausted");
+    c->position = SIZE (input_clauses);
     PUSH (input_clauses, c);
+  }
   statistics.added++;
   return c;
 }
 
+// Unit and binary lemmas are inlined in the clause index if possible,
+// except for backward checking and propagation, which need the position
+// of the lemma in the log respectively its watcher.
+
+static bool inlinable_line (void) {
+  const size_t size = SIZE (line.lits);
+  if (!size || size > 2)
+    return false;
+  const int *lits = line.lits.begin;
+  for (size_t i = 0; i != size; i++)
+    if (abs (lits[i]) > max_inlined_variable)
+      return false;
+  return size == 1 || lits[0] != -lits[1];
+}
+
+static struct clause *new_lemma (void) {
+  if (backward || propagate || !inlinable_line ())
+    return allocate_clause (false);
+  statistics.added++;
+  statistics.inlined++;
+  return inline_clause (SIZE (line.lits), line.lits.begin);
+}
+
+// Turns an inlined clause into an actual clause.
+
+static struct clause *uninline_clause (int64_t id, struct clause *c) {
+  int lits[2];
+  unsigned size = inlined_literals (c, lits);
+  const unsigned width = literal_width (size, lits);
+  struct clause *res = allocate_clause_memory (size, width);
+  res->id = id;
+#ifndef NDEBUG
+  res->lineno = 0;
+#endif
+  res->size = size;
+  res->width = width;
+  res->weakened = false;
+  res->input = false;
+  res->tautological = false;
+  store_literals (res, lits);
+  debug_clause (res, "uninlined");
+  return res;
+}
+
 static void free_clause (struct clause *c) {
   debug ("freeing clause at %p", (void *) c);
   debug_clause (c, "freeing");
-  free (c);
+  const size_t bytes = clause_bytes (c->size, c->width);
+  if (bytes > max_arena_clause_bytes) {
+    struct block *block = large_clause_block (c);
+    struct block *prev = block->prev, *next = block->next;
+    if (prev)
+      prev->next = next;
+    else
+      clause_store.large = next;
+    if (next)
+      next->prev = prev;
+    free (block);
+  } else {
+    struct free_clause **free_list =
+        clause_store.free + bytes / clause_alignment;
+    struct free_clause *f = (struct free_clause *) c;
+    f->next = *free_list;
+    *free_list = f;
+    assert (clause_store.live >= bytes);
+    clause_store.live -= bytes;
+  }
 }
 
 /*------------------------------------------------------------------------*/
@@ -1233,94 +2640,215 @@ static bool is_power_of_two (size_t n) { return n && !(n & (n - 1)); }
 
 #endif
 
-static const char *hash_table_name (struct hash_table *hash_table) {
-  return hash_table == &active ? "active" : "inactive";
-}
+// The hashed part of the clause index uses linear probing on the keys.
+// Identifiers are mixed by multiplying with the golden ratio and folding
+// the upper half of the product into the lower half, such that strided
+// identifiers do not cluster.  Removing a clause shifts the following
+// clauses of its probe sequence backward instead of leaving tombstones.
+// Thus probe sequences only contain live clauses and always end at an
+// empty slot as the table is kept at most half full.  The table shrinks
+// again if less than an eighth of it is occupied, but never below its
+// 'reserved' size (see 'presize').
+
+#define min_hash_table_size 16
 
 static size_t reduce_hash (int64_t id, size_t size) {
   assert (id > 0);
   assert (is_power_of_two (size));
-  return ((size_t) id) & (size - 1);
+  uint64_t hash = (uint64_t) id * 0x9e3779b97f4a7c15u;
+  hash ^= hash >> 32;
+  return hash & (size - 1);
 }
 
-static void enlarge_hash_table (struct hash_table *hash_table) {
-  size_t old_size = hash_table->size;
-  size_t old_count = hash_table->count;
+static void resize_hash_table (struct hash_table *hash_table,
+                               size_t new_size) {
+  const size_t old_size = hash_table->size;
+  int64_t *old_keys = hash_table->keys;
   struct clause **old_table = hash_table->table;
-  size_t new_size = old_size ? 2 * old_size : 1;
-  debug ("enlarging %s clause hash table to %zu",
-         hash_table_name (hash_table), new_size);
+  assert (2 * hash_table->count < new_size);
+  assert (is_power_of_two (new_size));
+  debug ("resizing clause hash table from %zu to %zu", old_size, new_size);
   struct clause **new_table = calloc (new_size, sizeof *new_table);
-  if (!new_table)
-    out_of_memory ("enlarging %s clause hash table of size %zu",
-                   hash_table_name (hash_table), old_size);
-  size_t removed = 0;
-  struct clause **const end_of_old_table = old_table + old_size;
+  int64_t *new_keys = calloc (new_size, sizeof *new_keys);
+  if (!new_table || !new_keys)
+    out_of_memory ("resizing clause hash table to %zu", new_size);
+  const size_t mask = new_size - 1;
 #ifndef NDEBUG
-  size_t old_clauses = 0;
-  for (struct clause **p = old_table; p != end_of_old_table; p++)
-    if (VALID (*p))
-      old_clauses++;
+  size_t moved = 0;
 #endif
-  for (struct clause **p = old_table; p != end_of_old_table; p++) {
-    struct clause *c = *p;
-    if (!c)
+  for (size_t i = 0; i != old_size; i++) {
+    int64_t key = old_keys[i];
+    if (!key)
       continue;
-    if (c == REMOVED) {
-      removed++;
-      continue;
-    }
-    size_t new_pos = reduce_hash (c->id, new_size);
-    while (new_table[new_pos])
-      if (++new_pos == new_size)
-        new_pos = 0;
-    new_table[new_pos] = c;
-  }
-  size_t new_count = old_count - removed;
-  hash_table->count = new_count;
-  hash_table->size = new_size;
-  hash_table->table = new_table;
+    size_t pos = reduce_hash (key, new_size);
+    while (new_keys[pos])
+      pos = (pos + 1) & mask;
+    new_keys[pos] = key;
+    new_table[pos] = old_table[i];
 #ifndef NDEBUG
-  size_t new_clauses = 0;
-  struct clause **const end_of_new_table = new_table + new_size;
-  for (struct clause **p = new_table; p != end_of_new_table; p++)
-    if (VALID (*p))
-      new_clauses++;
-  assert (old_clauses == new_clauses);
-  assert (new_count == new_clauses);
+    moved++;
 #endif
+  }
+  assert (moved == hash_table->count);
+  hash_table->size = new_size;
+  hash_table->keys = new_keys;
+  hash_table->table = new_table;
+  free (old_keys);
   free (old_table);
 }
 
-static struct clause *find_clause (struct hash_table *hash_table,
-                                   int64_t id) {
+static void enlarge_hash_table (struct hash_table *hash_table) {
+  size_t old_size = hash_table->size;
+  resize_hash_table (hash_table,
+                     old_size ? 2 * old_size : min_hash_table_size);
+}
+
+static void shrink_hash_table (struct hash_table *hash_table) {
   size_t size = hash_table->size;
-  struct clause *res = 0;
-  if (size) {
-    struct clause **table = hash_table->table;
-    size_t start = reduce_hash (id, size), pos = start;
-    for (;;) {
-      res = table[pos];
-      if (!res)
-        break;
-      if (res != REMOVED && res->id == id)
-        break;
-      if (++pos == size)
-        pos = 0;
-      if (pos == start) {
-        res = 0;
-        break;
-      }
-    }
+  if (size <= min_hash_table_size || size <= hash_table->reserved)
+    return;
+  if (8 * hash_table->count >= size)
+    return;
+  resize_hash_table (hash_table, size / 2);
+}
+
+// Most solvers produce (more or less) increasing and dense clause
+// identifiers.  Those are mapped directly through pages of 'id_page_size'
+// clause slots instead of hashing them, which turns finding antecedents
+// into a single indexed load.  Identifiers are mapped directly as long as
+// their page index stays within twice the number of pages needed for all
+// added clauses.  Sparse (or huge) identifiers are hashed instead.
+// Since this bound grows over time, an identifier might have been hashed
+// before it becomes mappable and thus 'find_clause' falls back to the
+// hash table if its direct slot is empty.  If only a few clauses remain
+// in an old page, i.e., after most clauses in its identifier range have
+// been deleted, these are moved to the hash table and the page is freed.
+
+#define id_page_bits 12
+#define id_page_size ((size_t) 1 << id_page_bits)
+#define min_direct_pages 16
+#define sparse_page_count (id_page_size / 64)
+
+static bool direct_id (int64_t id) {
+  assert (id > 0);
+  size_t page = (uint64_t) id >> id_page_bits;
+  return page <= 2 * (statistics.added >> id_page_bits) + min_direct_pages;
+}
+
+static struct clause **find_direct_slot (struct hash_table *hash_table,
+                                         int64_t id) {
+  size_t page = (uint64_t) id >> id_page_bits;
+  if (page >= hash_table->num_pages)
+    return 0;
+  struct id_page *id_page = hash_table->pages[page];
+  if (!id_page)
+    return 0;
+  return id_page->slots + (id & (id_page_size - 1));
+}
+
+static void enlarge_pages (struct hash_table *hash_table, size_t needed) {
+  size_t old_size = hash_table->num_pages;
+  assert (old_size < needed);
+  size_t new_size = old_size ? 2 * old_size : 1;
+  while (new_size < needed)
+    new_size *= 2;
+  debug ("enlarging clause pages to %zu", new_size);
+  struct id_page **pages =
+      realloc (hash_table->pages, new_size * sizeof *pages);
+  if (!pages)
+    out_of_memory ("enlarging clause pages to %zu", new_size);
+  memset (pages + old_size, 0, (new_size - old_size) * sizeof *pages);
+  hash_table->pages = pages;
+  hash_table->num_pages = new_size;
+}
+
+static struct clause **new_direct_slot (struct hash_table *hash_table,
+                                        int64_t id) {
+  size_t page = (uint64_t) id >> id_page_bits;
+  if (page >= hash_table->num_pages)
+    enlarge_pages (hash_table, page + 1);
+  struct id_page *id_page = hash_table->pages[page];
+  if (!id_page) {
+    id_page = calloc (1, sizeof *id_page + id_page_size * sizeof (void *));
+    if (!id_page)
+      out_of_memory ("allocating clause page");
+    hash_table->pages[page] = id_page;
+    if (page > hash_table->max_page)
+      hash_table->max_page = page;
   }
+  id_page->count++;
+  return id_page->slots + (id & (id_page_size - 1));
+}
+
+static void insert_hashed_clause (struct hash_table *, int64_t,
+                                  struct clause *);
+
+static void evict_page (struct hash_table *hash_table, size_t page) {
+  struct id_page *id_page = hash_table->pages[page];
+  debug ("evicting %zu clauses of clause page %zu", id_page->count, page);
+  hash_table->pages[page] = 0;
+  const int64_t first = (int64_t) (page << id_page_bits);
+  for (size_t i = 0; i != id_page_size; i++) {
+    struct clause *c = id_page->slots[i];
+    if (c)
+      insert_hashed_clause (hash_table, first + i, c);
+  }
+  free (id_page);
+}
+
+static bool remove_direct_clause (struct hash_table *hash_table,
+                                  int64_t id) {
+  struct clause **slot = find_direct_slot (hash_table, id);
+  if (!slot || !*slot)
+    return false;
+  *slot = 0;
+  size_t page = (uint64_t) id >> id_page_bits;
+  struct id_page *id_page = hash_table->pages[page];
+  assert (id_page->count);
+  size_t count = --id_page->count;
+  if (!count) {
+    hash_table->pages[page] = 0;
+    free (id_page);
+  } else if (count < sparse_page_count && page < hash_table->max_page)
+    evict_page (hash_table, page);
+  return true;
+}
+
+static struct clause **find_hashed_slot (struct hash_table *hash_table,
+                                         int64_t id) {
+  const size_t size = hash_table->size;
+  if (!size)
+    return 0;
+  const size_t mask = size - 1;
+  const int64_t *keys = hash_table->keys;
+  for (size_t pos = reduce_hash (id, size);; pos = (pos + 1) & mask) {
+    int64_t key = keys[pos];
+    if (!key)
+      return 0;
+    if (key == id)
+      return hash_table->table + pos;
+  }
+}
+
+static struct clause **find_slot (struct hash_table *hash_table,
+                                  int64_t id) {
+  struct clause **slot = find_direct_slot (hash_table, id);
+  if ((!slot || !*slot) && hash_table->count)
+    slot = find_hashed_slot (hash_table, id);
+  return slot;
+}
+
+static struct clause *find_clause (struct hash_table *hash_table,
+                                   int64_t id) {
+  struct clause **slot = find_slot (hash_table, id);
+  struct clause *res = slot ? *slot : 0;
+  assert (!res || inlined (res) || res->id == id);
 #ifndef NDEBUG
   if (res)
-    debug_clause (res, "found in %s clause hash table",
-                  hash_table_name (hash_table));
+    debug_clause (res, "found in clause hash table");
   else
     debug ("could not find clause with identifier %" PRId64
-           " in %s clause hash table",
-           id, hash_table_name (hash_table));
+           " in clause hash table", id);
 #endif
   return res;
 }
@@ -1331,48 +2859,233 @@ static bool is_full_hash_table (struct hash_table *hash_table) {
   return 2 * count >= size;
 }
 
-static void insert_clause (struct hash_table *hash_table,
-                           struct clause *c) {
-  debug_clause (c, "inserting in %s clause hash table",
-                hash_table_name (hash_table));
+// Returns the slot with the given key or otherwise a new reserved slot.
+
+static struct clause **find_or_new_hash_slot (struct hash_table *hash_table,
+                                              int64_t id) {
   if (is_full_hash_table (hash_table))
     enlarge_hash_table (hash_table);
-  size_t size = hash_table->size;
-  size_t start = reduce_hash (c->id, size), pos = start;
+  const size_t size = hash_table->size;
+  const size_t mask = size - 1;
+  int64_t *keys = hash_table->keys;
+  size_t pos = reduce_hash (id, size);
+  for (int64_t key; (key = keys[pos]); pos = (pos + 1) & mask)
+    if (key == id)
+      return hash_table->table + pos;
+  keys[pos] = id;
+  hash_table->count++;
+  assert (!hash_table->table[pos]);
+  return hash_table->table + pos;
+}
+
+static void insert_hashed_clause (struct hash_table *hash_table,
+                                  int64_t id, struct clause *c) {
+  struct clause **slot = find_or_new_hash_slot (hash_table, id);
+  assert (!*slot);
+  *slot = c;
+}
+
+// Combined search and insertion for new clauses, which returns the slot
+// of the clause with the given identifier if it exists and otherwise
+// reserves a new empty slot for it (to be filled by the caller).
+
+static struct clause **find_or_new_slot (struct hash_table *hash_table,
+                                         int64_t id) {
+  struct clause **slot = find_direct_slot (hash_table, id);
+  if (slot && *slot)
+    return slot;
+  if (!direct_id (id))
+    return find_or_new_hash_slot (hash_table, id);
+  if (hash_table->count) {
+    struct clause **hashed = find_hashed_slot (hash_table, id);
+    if (hashed)
+      return hashed;
+  }
+  return new_direct_slot (hash_table, id);
+}
+
+static void remove_hashed_clause (struct hash_table *hash_table,
+                                  int64_t id) {
+  const size_t size = hash_table->size;
+  const size_t mask = size - 1;
+  int64_t *keys = hash_table->keys;
   struct clause **table = hash_table->table;
-  for (;;) {
-    struct clause *res = table[pos];
-    if (res == REMOVED)
-      break;
-    if (!res) {
-      hash_table->count++;
-      break;
-    }
-    assert (res != c);
-    if (++pos == size)
-      pos = 0;
-    assert (pos != start);
+  size_t pos = reduce_hash (id, size);
+  while (keys[pos] != id) {
+    assert (keys[pos]);
+    pos = (pos + 1) & mask;
+  }
+  assert (table[pos]);
+  for (size_t next = (pos + 1) & mask; keys[next];
+       next = (next + 1) & mask) {
+    size_t home = reduce_hash (keys[next], size);
+    if (((next - home) & mask) < ((next - pos) & mask))
+      continue;
+    keys[pos] = keys[next];
+    table[pos] = table[next];
+    pos = next;
   }
-  table[pos] = c;
+  keys[pos] = 0;
+  table[pos] = 0;
+  assert (hash_table->count);
+  hash_table->count--;
+  shrink_hash_table (hash_table);
 }
 
-static void remove_clause (struct hash_table *hash_table,
-                           struct clause *c) {
-  debug_clause (c, "removing from %s clause hash table",
-                hash_table_name (hash_table));
-  size_t size = hash_table->size;
+static void remove_clause (struct hash_table *hash_table, int64_t id) {
+  debug ("removing clause %" PRId64 " from clause hash table", id);
+  if (!remove_direct_clause (hash_table, id))
+    remove_hashed_clause (hash_table, id);
+}
+
+/*------------------------------------------------------------------------*/
+
+// After deletion heavy phases live clauses are scattered over the arenas
+// and consecutive antecedents in 'check_implied' rarely share a cache
+// line.  If more than half of the bump allocated arena memory consists of
+// freed clauses (and at least 'compact_bytes' are wasted) we copy all
+// live clauses in order of their identifier into fresh arenas.  Clauses
+// derived close together by the solver are thus stored close together
+// too.  While copying the first word of a moved clause is overwritten by
+// a forwarding pointer (as for freed clauses on the free lists) which is
+// then used to update the clause index, the input clause stack and the
+// links of the weakened clause list.  Large clauses have their own blocks
+// and are not moved.  Compaction can only happen between lines, as only
+// these reference clauses between lines.  The cost of compaction is
+// linear in the number of live clauses and thus amortized by the freed
+// clauses.
+
+#define compact_min_bytes ((size_t) 1 << 24) // 16 MB
+
+static size_t compact_bytes = compact_min_bytes; // See '--compact'.
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+static bool in_arena (struct clause *c) {
+  return clause_bytes (c->size, c->width) <= max_arena_clause_bytes;
+}
+
+static struct clause **forwarding_pointer (struct clause *c) {
+  return (struct clause **) c;
+}
+
+static int cmp_clause_ids (const void *p, const void *q) {
+  const struct clause *c = *(struct clause *const *) p;
+  const struct clause *d = *(struct clause *const *) q;
+  return (c->id > d->id) - (c->id < d->id);
+}
+
+static void collect_arena_clauses_in_slots (struct clauses *clauses,
+                                            struct clause **begin,
+                                            struct clause **end) {
+  for (struct clause **p = begin; p != end; p++) {
+    struct clause *c = *p;
+    if (c && !inlined (c) && !c->input && in_arena (c))
+      PUSH (*clauses, c);
+  }
+}
+
+static void forward_arena_clauses_in_slots (struct clause **begin,
+                                            struct clause **end) {
+  for (struct clause **p = begin; p != end; p++) {
+    struct clause *c = *p;
+    if (c && !inlined (c) && in_arena (c))
+      *p = *forwarding_pointer (c);
+  }
+}
+
+static void collect_arena_clauses (struct clauses *clauses,
+                                   struct hash_table *hash_table) {
   struct clause **table = hash_table->table;
-  size_t start = reduce_hash (c->id, size), pos = start;
-  for (;;) {
-    struct clause *res = table[pos];
-    if (res == c)
-      break;
-    assert (res);
-    if (++pos == size)
-      pos = 0;
-    assert (pos != start);
+  collect_arena_clauses_in_slots (clauses, table, table + hash_table->size);
+  for (size_t i = 0; i != hash_table->num_pages; i++) {
+    struct id_page *id_page = hash_table->pages[i];
+    if (id_page)
+      collect_arena_clauses_in_slots (clauses, id_page->slots,
+                                      id_page->slots + id_page_size);
+  }
+}
+
+static void forward_arena_clauses (struct hash_table *hash_table) {
+  struct clause **table = hash_table->table;
+  forward_arena_clauses_in_slots (table, table + hash_table->size);
+  for (size_t i = 0; i != hash_table->num_pages; i++) {
+    struct id_page *id_page = hash_table->pages[i];
+    if (id_page)
+      forward_arena_clauses_in_slots (id_page->slots,
+                                      id_page->slots + id_page_size);
   }
-  table[pos] = REMOVED;
+}
+
+static struct clause *forward_clause (struct clause *c) {
+  return c && in_arena (c) ? *forwarding_pointer (c) : c;
+}
+
+static void forward_weakened_clauses (void) {
+  for (struct epoch *e = epochs.begin; e != epochs.end; e++) {
+    e->first = forward_clause (e->first);
+    e->last = forward_clause (e->last);
+    for (struct clause *c = e->first; c; c = c->next_weakened) {
+      c->prev_weakened = forward_clause (c->prev_weakened);
+      c->next_weakened = forward_clause (c->next_weakened);
+    }
+  }
+}
+
+static void forward_watchers (void);
+
+static void compact_clauses (void) {
+  const size_t old_bumped = clause_store.bumped;
+  struct clauses clauses = {0, 0, 0};
+  for (all_pointers (struct clause, c, input_clauses))
+    if (in_arena (c))
+      PUSH (clauses, c);
+  collect_arena_clauses (&clauses, &clause_index);
+  qsort (clauses.begin, SIZE (clauses), sizeof *clauses.begin,
+         cmp_clause_ids);
+  struct block *old_arenas = clause_store.arenas;
+  clause_store.arenas = 0;
+  clause_store.top = clause_store.end = 0;
+  clause_store.bumped = clause_store.live = 0;
+  memset (clause_store.free, 0, sizeof clause_store.free);
+  for (all_pointers (struct clause, c, clauses)) {
+    struct clause *moved = allocate_clause_memory (c->size, c->width);
+    memcpy (moved, c, clause_bytes (c->size, c->width));
+    *forwarding_pointer (c) = moved;
+  }
+  forward_arena_clauses (&clause_index);
+  forward_weakened_clauses ();
+  forward_watchers ();
+  for (struct clause **p = input_clauses.begin; p != input_clauses.end;
+       p++)
+    if (in_arena (*p))
+      *p = *forwarding_pointer (*p);
+  release_blocks (old_arenas);
+#ifdef __GLIBC__
+  (void) malloc_trim (0);
+#endif
+  statistics.compactions++;
+  verbose ("compaction %zu moved %zu clauses shrinking arenas "
+           "from %.0f MB to %.0f MB",
+           statistics.compactions, SIZE (clauses),
+           old_bumped / (double) (1 << 20),
+           clause_store.bumped / (double) (1 << 20));
+  RELEASE (clauses);
+}
+
+static void synchronize_lemma_checks (void);
+
+static void compact_clauses_if_fragmented (void) {
+  assert (clause_store.live <= clause_store.bumped);
+  const size_t wasted = clause_store.bumped - clause_store.live;
+  if (wasted < compact_bytes)
+    return;
+  if (wasted <= clause_store.live)
+    return;
+  synchronize_lemma_checks ();
+  compact_clauses ();
 }
 
 /*------------------------------------------------------------------------*/
@@ -1422,103 +3135,903 @@ static void insert_bit (struct bit_table *bits, int64_t id) {
 
 /*------------------------------------------------------------------------*/
 
-// The assumptions in the query have to be saved until the query ends.
+// The assumptions in the query have to be saved until the query ends.
+
+static void save_query (void) {
+  debug ("saving query");
+  COPY (int, query, line.lits);
+  start_of_query = file->start_of_line;
+  statistics.queries++;
+}
+
+/*------------------------------------------------------------------------*/
+
+// This is the essential checking function which checks that added lemmas
+// are indeed reverse unit propagation (RUP) implied and unsatisfiable
+// cores are indeed unsatisfiable.  The first case requires the literals
+// in the current line to be assumed negatively while the second case
+// requires them to be assigned positively, as determined by the last
+// 'sign' argument. The other arguments are for context sensitive logging
+// and error messages.
+
+// Resolving long chains of antecedents is bound by memory latency, as
+// finding an antecedent and then accessing its literals are two dependent
+// cache misses, first on the slot in the clause index and then on the
+// clause.  Therefore we first issue prefetches for the slots of all
+// antecedents, which overlap with assigning the literals of the line.
+// Then all antecedents are found (now hitting mostly cached slots) and
+// for each found clause its header and first literals are prefetched,
+// before actually resolving them in order.  Negative and missing
+// antecedents are kept as zero pointers and only reported if resolution
+// reaches them, which keeps the error behaviour unchanged.
+
+#ifdef __GNUC__
+#define prefetch(P) __builtin_prefetch (P)
+#else
+#define prefetch(P) \
+  do { \
+  } while (0)
+#endif
+
+static void prefetch_slot (struct hash_table *hash_table, int64_t id) {
+  struct clause **slot = find_direct_slot (hash_table, id);
+  if (slot)
+    prefetch (slot);
+  else if (hash_table->size) {
+    size_t pos = reduce_hash (id, hash_table->size);
+    prefetch (hash_table->keys + pos);
+    prefetch (hash_table->table + pos);
+  }
+}
+
+static void prefetch_antecedent_slots (void) {
+  for (all_elements (int64_t, id, line.ids))
+    if (id > 0)
+      prefetch_slot (&clause_index, id);
+}
+
+static void find_and_prefetch_antecedents (void) {
+  CLEAR (antecedents);
+  for (all_elements (int64_t, id, line.ids)) {
+    struct clause *c = id > 0 ? find_clause (&clause_index, id) : 0;
+    if (c && !inlined (c))
+      prefetch (c);
+    PUSH (antecedents, c);
+  }
+}
+
+// Resolving an antecedent requires all its literals but at most one to be
+// falsified.  This remaining 'unit' literal is assigned if it is not
+// already satisfied and returned (zero for conflicting antecedents).  The
+// loop over the literals is specialized for each literal width.
+
+static inline bool resolve_literal (int lit, int *unit) {
+  signed char value = values[lit];
+  if (value == -1)
+    return true;
+  if (*unit && *unit != lit)
+    return false;
+  *unit = lit;
+  if (!value)
+    assign (lit);
+  else if (value == 2)
+    cite_root_literal (lit);
+  else if (value == -2) {
+    root.conflict = true;
+    return false;
+  }
+  return true;
+}
+
+static bool resolve_antecedent (struct clause *c, int *unit_ptr) {
+  int unit = 0;
+  if (inlined (c)) {
+    int lits[2];
+    unsigned size = inlined_literals (c, lits);
+    for (unsigned i = 0; i != size; i++)
+      if (!resolve_literal (lits[i], &unit))
+        return false;
+  } else
+    switch (c->width) {
+    case 1:
+      for (all_literals_of_width (int8_t, lit, c))
+        if (!resolve_literal (lit, &unit))
+          return false;
+      break;
+    case 2:
+      for (all_literals_of_width (int16_t, lit, c))
+        if (!resolve_literal (lit, &unit))
+          return false;
+      break;
+    default:
+      assert (c->width == 4);
+      for (all_literals_of_width (int, lit, c))
+        if (!resolve_literal (lit, &unit))
+          return false;
+      break;
+    }
+  *unit_ptr = unit;
+  return true;
+}
+
+/*------------------------------------------------------------------------*/
+
+// With '--propagate' lemmas and cores with an empty or incomplete chain
+// of antecedents are not rejected right away.  Instead, after resolving
+// all given antecedents, the resulting assignment is propagated over all
+// active clauses as in DRUP checking.  Lemmas with complete chains are
+// still only checked by following their chain.  Active clauses are
+// watched by two literals as usual.  However, the watched literals are
+// not moved to the front of the clause but kept in a separate 'watcher'
+// of the clause, since literals are stored with different widths.
+// Clauses are not inlined in this mode, such that the 'position' field
+// of a clause can hold the index of its watcher.  Watchers are only
+// created when propagation is needed for the first time and from then on
+// kept up-to-date.  Watchers of deleted and weakened clauses are
+// invalidated and watches to them are removed lazily during propagation.
+// If more than half of the watchers are invalid they are all rebuilt.
+
+struct watcher {
+  struct clause *clause; // Zero if deleted, weakened or not watched.
+  int lits[2];           // Watched literals (zero if missing).
+};
+
+struct watchers {
+  struct watcher *begin, *end, *allocated;
+};
+
+static struct {
+  bool watching;            // Watchers created.
+  size_t invalid;           // Number of invalid watchers.
+  struct watchers watchers; // Indexed by the 'position' of clauses.
+  struct positions units;   // Watchers of unit and empty clauses.
+} propagation;
+
+static void watch_clause (struct clause *c) {
+  if (!propagation.watching)
+    return;
+  assert (!inlined (c));
+  assert (!c->weakened);
+  const size_t position = SIZE (propagation.watchers);
+  if (position > UINT_MAX)
+    die ("maximum number of watchers exhausted");
+  c->position = position;
+  struct watcher watcher = {c, {0, 0}};
+  if (c->tautological) {
+    watcher.clause = 0;
+    propagation.invalid++;
+  } else if (c->size) {
+    const int first = get_literal (c, 0);
+    watcher.lits[0] = first;
+    for (unsigned i = 1; !watcher.lits[1] && i != c->size; i++) {
+      const int lit = get_literal (c, i);
+      if (lit != first)
+        watcher.lits[1] = lit;
+    }
+    if (watcher.lits[1]) {
+      PUSH (watches[watcher.lits[0]], position);
+      PUSH (watches[watcher.lits[1]], position);
+    } else
+      PUSH (propagation.units, position);
+  } else
+    PUSH (propagation.units, position);
+  PUSH (propagation.watchers, watcher);
+}
+
+// The 'position' of clauses not watched is stale or undefined.  Thus we
+// need to check that the watcher at that position is the one of 'c'.
+
+static void unwatch_clause (struct clause *c) {
+  if (!propagation.watching)
+    return;
+  assert (!inlined (c));
+  if (c->position >= SIZE (propagation.watchers))
+    return;
+  struct watcher *watcher = propagation.watchers.begin + c->position;
+  if (watcher->clause != c)
+    return;
+  watcher->clause = 0;
+  propagation.invalid++;
+}
+
+static void watch_clauses_in_slots (struct clause **begin,
+                                    struct clause **end) {
+  for (struct clause **p = begin; p != end; p++) {
+    struct clause *c = *p;
+    if (c && !c->weakened)
+      watch_clause (c);
+  }
+}
+
+static void rebuild_watchers (void) {
+  if (max_var)
+    for (int lit = -max_var; lit <= max_var; lit++)
+      CLEAR (watches[lit]);
+  CLEAR (propagation.watchers);
+  CLEAR (propagation.units);
+  propagation.invalid = 0;
+  propagation.watching = true;
+  struct clause **table = clause_index.table;
+  watch_clauses_in_slots (table, table + clause_index.size);
+  for (size_t i = 0; i != clause_index.num_pages; i++) {
+    struct id_page *id_page = clause_index.pages[i];
+    if (id_page)
+      watch_clauses_in_slots (id_page->slots, id_page->slots + id_page_size);
+  }
+  statistics.rebuilds++;
+  verbose ("rebuilt %zu watchers", SIZE (propagation.watchers));
+}
+
+static void forward_watchers (void) {
+  if (!propagation.watching)
+    return;
+  for (struct watcher *w = propagation.watchers.begin;
+       w != propagation.watchers.end; w++)
+    w->clause = forward_clause (w->clause);
+}
+
+static bool propagate_units (void) {
+  unsigned *q = propagation.units.begin;
+  const unsigned *p = q, *end = propagation.units.end;
+  bool res = true;
+  while (p != end) {
+    const unsigned position = *p++;
+    struct watcher *w = propagation.watchers.begin + position;
+    if (!w->clause)
+      continue;
+    *q++ = position;
+    const int unit = w->lits[0];
+    const signed char value = unit ? values[unit] : -1;
+    if (value < 0)
+      res = false;
+    else if (!value && res)
+      assign (unit);
+  }
+  propagation.units.end = q;
+  return res;
+}
+
+// Returns 'false' if propagation over the watched literals runs into a
+// conflict.  The current trail is propagated from the start, i.e., it
+// includes the negated literals of the line and the resolved units.
+
+static bool propagate_watches (void) {
+  for (const int *p = trail.begin; p != trail.end; p++) {
+    const int lit = -*p;
+    statistics.propagations++;
+    struct positions *ws = watches + lit;
+    unsigned *q = ws->begin;
+    const unsigned *r = q, *end = ws->end;
+    while (r != end) {
+      const unsigned position = *r++;
+      struct watcher *w = propagation.watchers.begin + position;
+      struct clause *c = w->clause;
+      if (!c)
+        continue;
+      const int other = w->lits[0] ^ w->lits[1] ^ lit;
+      const signed char value = values[other];
+      if (value > 0) {
+        *q++ = position;
+        continue;
+      }
+      int replacement = 0;
+      for (unsigned i = 0; !replacement && i != c->size; i++) {
+        const int k = get_literal (c, i);
+        if (k != lit && k != other && values[k] >= 0)
+          replacement = k;
+      }
+      if (replacement) {
+        w->lits[0] = other;
+        w->lits[1] = replacement;
+        PUSH (watches[replacement], position);
+        continue;
+      }
+      *q++ = position;
+      if (value < 0) {
+        debug_clause (c, "propagation conflict");
+        while (r != end)
+          *q++ = *r++;
+        ws->end = q;
+        return false;
+      }
+      assign (other);
+    }
+    ws->end = q;
+  }
+  return true;
+}
+
+static bool propagate_to_conflict (void) {
+  if (!propagation.watching ||
+      2 * propagation.invalid > SIZE (propagation.watchers))
+    rebuild_watchers ();
+  return !propagate_units () || !propagate_watches ();
+}
+
+static void release_watchers (void) {
+  if (watches) {
+    for (int lit = -max_var; lit <= max_var; lit++)
+      RELEASE (watches[lit]);
+    watches -= allocated;
+    free (watches);
+  }
+  RELEASE (propagation.watchers);
+  RELEASE (propagation.units);
+}
+
+static void check_implied (int type, const char *type_str, int sign) {
+
+  assert (sign == 1 || sign == -1);
+
+  if (inconsistent) {
+    debug ("skipping %s implication check as formula already inconsistent",
+           type_str);
+    return;
+  }
+
+  statistics.checks++;
+#ifndef NDEBUG
+  if (sign < 0)
+    debug ("checking unsatisfiable core justified");
+  else
+    debug ("checking lemma is justified");
+#endif
+
+  prefetch_antecedent_slots ();
+  reset_root_level ();
+
+RESTART_WITHOUT_ROOT_LEVEL:
+
+  debug ("assigning first all literals");
+  for (all_elements (int, lit, line.lits)) {
+    int signed_lit = sign * lit;
+    signed char value = values[signed_lit];
+    if (value == -1) {
+      debug ("skipping duplicated literal %s", debug_literal (signed_lit));
+      continue;
+    }
+    if (value == 1) {
+      debug ("found tautological literal %s", debug_literal (signed_lit));
+      goto IMPLICATION_CHECK_SUCCEEDED;
+    }
+    if (value == -2)
+      cite_root_literal (-signed_lit);
+    else if (value == 2) {
+      root.conflict = true;
+      clear_root_level ();
+      goto RESTART_WITHOUT_ROOT_LEVEL;
+    } else
+      assign (-signed_lit);
+  }
+
+  find_and_prefetch_antecedents ();
+
+  struct clause **antecedent = antecedents.begin;
+  for (all_elements (int64_t, id, line.ids)) {
+    if (id < 0)
+      line_error (type, "negative antecedent %" PRId64 " unsupported", id);
+    struct clause *c = *antecedent++;
+    if (!c)
+      line_error (type, "could not find antecedent %" PRId64, id);
+    if (clause_weakened (c))
+      line_error (type, "antecedent %" PRId64 " weakened", id);
+    statistics.resolutions++;
+    debug_clause (c, "resolving");
+    int unit;
+    if (!resolve_antecedent (c, &unit)) {
+      if (root.conflict) {
+        clear_root_level ();
+        goto RESTART_WITHOUT_ROOT_LEVEL;
+      }
+      line_error (type, "antecedent %" PRId64 " not resolvable", id);
+    }
+    if (!unit) {
+      debug_clause (c, "justifying conflicting");
+      statistics.chained++;
+      goto IMPLICATION_CHECK_SUCCEEDED;
+    }
+  }
+
+  if (propagate && propagate_to_conflict ()) {
+    debug ("%s justified by propagation", type_str);
+    statistics.propagated++;
+    goto IMPLICATION_CHECK_SUCCEEDED;
+  }
+
+  line_error (type, "%s resolution check failed:", type_str);
+
+IMPLICATION_CHECK_SUCCEEDED:
+
+  backtrack ();
+  uncite_root_literals ();
+
+  debug ("%s resolution check succeeded", type_str);
+  (void) type_str;
+}
+
+/*------------------------------------------------------------------------*/
+
+// With '--threads' lemmas are checked in parallel by a pool of worker
+// threads.  The main thread still parses all lines and maintains the
+// clause index.  For each lemma it only looks up the antecedents and then
+// queues the literals of the lemma and the found antecedent clauses in
+// the current batch of lemmas, adds the lemma to the clause index and
+// continues parsing.  Full batches are submitted to the workers, which
+// resolve lemmas exactly as 'check_implied' does, but on their own thread
+// local assignment and trail.  Antecedents are immutable until they are
+// deleted.  Therefore clauses deleted while batches are pending are only
+// freed after all batches submitted before have been completed.  Batches
+// are collected by the main thread in the order of submission, such that
+// the first failing lemma in the proof is reported.  Before concluding a
+// query, checking a core, compacting clause arenas and reporting any other
+// error the main thread waits for all queued lemmas to be checked.
+
+#define max_threads 1024        // Maximum number of worker threads.
+#define batch_size 256          // Maximum number of lemmas per batch.
+#define max_pending_batches 4   // Per worker thread.
+
+// The state of an antecedent is determined when the lemma is queued.
+
+enum antecedent_state {
+  VALID_ANTECEDENT = 0,
+  NEGATIVE_ANTECEDENT = 1,
+  MISSING_ANTECEDENT = 2,
+  WEAKENED_ANTECEDENT = 3,
+};
+
+// Reasons for failing lemma checks.
+
+enum failure {
+  NO_FAILURE = 0,
+  ANTECEDENT_FAILURE = 1,
+  NOT_RESOLVABLE_FAILURE = 2,
+  RESOLUTION_FAILURE = 3,
+};
+
+struct antecedent {
+  struct clause *clause; // Zero unless 'state == VALID_ANTECEDENT'.
+  int64_t id;
+  int state;
+};
+
+struct antecedents {
+  struct antecedent *begin, *end, *allocated;
+};
+
+struct queued_lemma {
+  int64_t id;
+  size_t lineno;
+  size_t end_lits;        // End of literals in 'batch->lits'.
+  size_t end_antecedents; // End of antecedents in 'batch->antecedents'.
+};
+
+struct queued_lemmas {
+  struct queued_lemma *begin, *end, *allocated;
+};
+
+struct batch {
+  struct batch *next;
+  size_t allocated; // Allocated variables when the batch was queued.
+  struct queued_lemmas lemmas;
+  struct lits lits;
+  struct antecedents antecedents;
+  bool done;                    // Set by worker after checking.
+  size_t resolutions;           // Set by worker after checking.
+  int failure;                  // Set by worker if a lemma failed.
+  struct queued_lemma *failed;  // Failed lemma.
+  struct antecedent *culprit;   // Failed antecedent.
+};
+
+struct deferred_clause {
+  struct clause *clause;
+  size_t batch; // Freed after this batch has been collected.
+};
+
+struct deferred_clauses {
+  struct deferred_clause *begin, *end, *allocated;
+};
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t work;     // Signaled on submission and termination.
+  pthread_cond_t finished; // Signaled after a batch has been checked.
+  pthread_t *workers;
+  struct batch *first;     // Submitted but not collected batches.
+  struct batch *last;      // Last submitted batch.
+  struct batch *next;      // First batch not claimed by a worker.
+  bool terminate;          // Set to terminate workers.
+  size_t pending;          // Number of submitted but not collected.
+  size_t submitted;        // Number of submitted batches.
+  size_t collected;        // Number of collected batches.
+  struct batch *current;   // Batch filled by the main thread.
+  struct batch *recycled;  // Collected batches for reuse.
+  // Clauses deleted while lemmas are pending.
+  struct deferred_clauses deferred;
+  size_t flushed;          // Deferred clauses already freed.
+  bool reporting;          // Avoid recursion while reporting failures.
+} pool;
+
+static void lock_pool (void) {
+  if (pthread_mutex_lock (&pool.lock))
+    fatal_error ("failed to lock worker pool");
+}
+
+static void unlock_pool (void) {
+  if (pthread_mutex_unlock (&pool.lock))
+    fatal_error ("failed to unlock worker pool");
+}
+
+// The thread local assignment and trail of a worker has to be large
+// enough for all variables allocated when the batch was queued.
+
+static void ensure_worker_allocated (size_t *worker_allocated,
+                                     size_t needed) {
+  if (*worker_allocated >= needed)
+    return;
+  if (*worker_allocated) {
+    values -= *worker_allocated;
+    free (values);
+  }
+  free (trail.begin);
+  values = calloc (2 * needed, sizeof *values);
+  trail.begin = malloc (needed * sizeof *trail.begin);
+  if (!values || !trail.begin)
+    out_of_memory ("allocating worker assignment of size %zu", needed);
+  values += needed;
+  trail.root = trail.end = trail.begin;
+  *worker_allocated = needed;
+}
+
+static int check_queued_lemma (struct batch *batch,
+                               struct queued_lemma *lemma,
+                               const int *lits, const int *end_lits,
+                               struct antecedent *antecedent,
+                               struct antecedent *end_antecedents) {
+  int res = RESOLUTION_FAILURE;
+  for (const int *p = lits; p != end_lits; p++) {
+    const int lit = *p;
+    signed char value = values[lit];
+    if (value < 0)
+      continue;
+    if (value > 0) {
+      res = NO_FAILURE;
+      goto DONE;
+    }
+    assign (-lit);
+  }
+  for (; antecedent != end_antecedents; antecedent++) {
+    if (antecedent->state != VALID_ANTECEDENT) {
+      res = ANTECEDENT_FAILURE;
+      break;
+    }
+    batch->resolutions++;
+    int unit;
+    if (!resolve_antecedent (antecedent->clause, &unit)) {
+      res = NOT_RESOLVABLE_FAILURE;
+      break;
+    }
+    if (!unit) {
+      res = NO_FAILURE;
+      break;
+    }
+  }
+  if (res != NO_FAILURE) {
+    batch->failed = lemma;
+    batch->culprit = antecedent;
+  }
+DONE:
+  backtrack ();
+  return res;
+}
+
+static void check_batch (struct batch *batch, size_t *worker_allocated) {
+  ensure_worker_allocated (worker_allocated, batch->allocated);
+  const int *lits = batch->lits.begin;
+  struct antecedent *antecedents = batch->antecedents.begin;
+  for (struct queued_lemma *lemma = batch->lemmas.begin;
+       lemma != batch->lemmas.end; lemma++) {
+    const int *end_lits = batch->lits.begin + lemma->end_lits;
+    struct antecedent *end_antecedents =
+        batch->antecedents.begin + lemma->end_antecedents;
+    int failure = check_queued_lemma (batch, lemma, lits, end_lits,
+                                      antecedents, end_antecedents);
+    if (failure) {
+      batch->failure = failure;
+      return;
+    }
+    lits = end_lits;
+    antecedents = end_antecedents;
+  }
+}
+
+static void *work (void *dummy) {
+  size_t worker_allocated = 0;
+  lock_pool ();
+  for (;;) {
+    while (!pool.next && !pool.terminate)
+      pthread_cond_wait (&pool.work, &pool.lock);
+    struct batch *batch = pool.next;
+    if (!batch)
+      break;
+    pool.next = batch->next;
+    unlock_pool ();
+    check_batch (batch, &worker_allocated);
+    lock_pool ();
+    batch->done = true;
+    pthread_cond_broadcast (&pool.finished);
+  }
+  unlock_pool ();
+  if (worker_allocated) {
+    values -= worker_allocated;
+    free (values);
+  }
+  free (trail.begin);
+  (void) dummy;
+  return 0;
+}
+
+static void start_workers (void) {
+  assert (threads);
+  message ("checking lemmas with %u worker threads", threads);
+  pthread_mutex_init (&pool.lock, 0);
+  pthread_cond_init (&pool.work, 0);
+  pthread_cond_init (&pool.finished, 0);
+  pool.workers = calloc (threads, sizeof *pool.workers);
+  if (!pool.workers)
+    out_of_memory ("allocating %u worker threads", threads);
+  for (unsigned i = 0; i != threads; i++)
+    if (pthread_create (pool.workers + i, 0, work, 0))
+      die ("failed to create worker thread %u", i);
+}
+
+static void print_queued_lemma (struct batch *batch,
+                                struct queued_lemma *lemma) {
+  size_t begin_lits = 0, begin_antecedents = 0;
+  if (lemma != batch->lemmas.begin) {
+    begin_lits = lemma[-1].end_lits;
+    begin_antecedents = lemma[-1].end_antecedents;
+  }
+  fprintf (stderr, "l %" PRId64, lemma->id);
+  for (size_t i = begin_lits; i != lemma->end_lits; i++)
+    fprintf (stderr, " %d", batch->lits.begin[i]);
+  fputs (" 0", stderr);
+  for (size_t i = begin_antecedents; i != lemma->end_antecedents; i++)
+    fprintf (stderr, " %" PRId64, batch->antecedents.begin[i].id);
+  fputs (" 0\n", stderr);
+}
+
+// Prints the error message of a failed lemma check without the lemma.
+
+static void print_lemma_check_failure (size_t lineno, int failure,
+                                       int state, int64_t id) {
+  fflush (stdout);
+  fprintf (stderr, "lidrup-check: error: at line %zu in '%s': ", lineno,
+           proof->name);
+  switch (failure) {
+  case ANTECEDENT_FAILURE:
+    if (state == NEGATIVE_ANTECEDENT)
+      fprintf (stderr, "negative antecedent %" PRId64 " unsupported", id);
+    else if (state == MISSING_ANTECEDENT)
+      fprintf (stderr, "could not find antecedent %" PRId64, id);
+    else {
+      assert (state == WEAKENED_ANTECEDENT);
+      fprintf (stderr, "antecedent %" PRId64 " weakened", id);
+    }
+    break;
+  case NOT_RESOLVABLE_FAILURE:
+    fprintf (stderr, "antecedent %" PRId64 " not resolvable", id);
+    break;
+  default:
+    assert (failure == RESOLUTION_FAILURE);
+    fputs ("lemma resolution check failed:", stderr);
+    break;
+  }
+  fputc ('\n', stderr);
+}
+
+static void report_failed_batch (struct batch *batch) {
+  struct queued_lemma *lemma = batch->failed;
+  struct antecedent *culprit = batch->culprit;
+  int state = culprit ? culprit->state : VALID_ANTECEDENT;
+  int64_t id = culprit ? culprit->id : 0;
+  print_lemma_check_failure (lemma->lineno, batch->failure, state, id);
+  print_queued_lemma (batch, lemma);
+  exit (1);
+}
+
+static void free_deferred_clauses (void) {
+  struct deferred_clause *begin = pool.deferred.begin + pool.flushed;
+  struct deferred_clause *p = begin, *end = pool.deferred.end;
+  while (p != end && p->batch <= pool.collected)
+    free_clause (p++->clause);
+  if (p == end) {
+    CLEAR (pool.deferred);
+    pool.flushed = 0;
+  } else
+    pool.flushed += p - begin;
+}
+
+// Collects checked batches in submission order and waits for batches to
+// be checked until at most 'max_pending' are left.
+
+static void collect_batches (size_t max_pending) {
+  lock_pool ();
+  for (;;) {
+    struct batch *batch = pool.first;
+    if (!batch)
+      break;
+    if (!batch->done) {
+      if (pool.pending <= max_pending)
+        break;
+      pthread_cond_wait (&pool.finished, &pool.lock);
+      continue;
+    }
+    if (batch->failure) {
+      unlock_pool ();
+      report_failed_batch (batch);
+    }
+    pool.first = batch->next;
+    if (!pool.first)
+      pool.last = 0;
+    assert (pool.pending);
+    pool.pending--;
+    pool.collected++;
+    statistics.resolutions += batch->resolutions;
+    batch->next = pool.recycled;
+    pool.recycled = batch;
+  }
+  unlock_pool ();
+  free_deferred_clauses ();
+}
+
+static void submit_batch (void) {
+  struct batch *batch = pool.current;
+  if (!batch || EMPTY (batch->lemmas))
+    return;
+  pool.current = 0;
+  collect_batches (max_pending_batches * threads - 1);
+  lock_pool ();
+  batch->next = 0;
+  if (pool.last)
+    pool.last->next = batch;
+  else
+    pool.first = batch;
+  pool.last = batch;
+  if (!pool.next)
+    pool.next = batch;
+  pool.pending++;
+  pool.submitted++;
+  pthread_cond_signal (&pool.work);
+  unlock_pool ();
+}
 
-static void save_query (void) {
-  debug ("saving query");
-  COPY (int, query, line.lits);
-  start_of_query = file->start_of_line;
-  statistics.queries++;
+static struct batch *current_batch (void) {
+  struct batch *batch = pool.current;
+  if (batch)
+    return batch;
+  batch = pool.recycled;
+  if (batch) {
+    pool.recycled = batch->next;
+    CLEAR (batch->lemmas);
+    CLEAR (batch->lits);
+    CLEAR (batch->antecedents);
+  } else {
+    batch = calloc (1, sizeof *batch);
+    if (!batch)
+      out_of_memory ("allocating lemma batch");
+  }
+  batch->done = false;
+  batch->resolutions = 0;
+  batch->failure = NO_FAILURE;
+  batch->failed = 0;
+  batch->culprit = 0;
+  pool.current = batch;
+  return batch;
 }
 
-/*------------------------------------------------------------------------*/
+static bool pending_lemmas (void) {
+  return pool.pending || (pool.current && !EMPTY (pool.current->lemmas));
+}
 
-// This is the essential checking function which checks that added lemmas
-// are indeed reverse unit propagation (RUP) implied and unsatisfiable
-// cores are indeed unsatisfiable.  The first case requires the literals
-// in the current line to be assumed negatively while the second case
-// requires them to be assigned positively, as determined by the last
-// 'sign' argument. The other arguments are for context sensitive logging
-// and error messages.
+// Waits until all queued lemmas are checked and reports failures.
 
-static void check_implied (int type, const char *type_str, int sign) {
+static void synchronize_lemma_checks (void) {
+  if (!threads || !pending_lemmas ())
+    return;
+  submit_batch ();
+  collect_batches (0);
+  assert (!pool.pending);
+  assert (EMPTY (pool.deferred));
+}
 
-  assert (sign == 1 || sign == -1);
+static void report_failed_queued_lemma (void) {
+  if (!threads || pool.reporting)
+    return;
+  pool.reporting = true;
+  synchronize_lemma_checks ();
+}
 
+static void queue_lemma (void) {
   if (inconsistent) {
-    debug ("skipping %s implication check as formula already inconsistent",
-           type_str);
+    debug ("skipping queueing lemma as formula already inconsistent");
     return;
   }
-
   statistics.checks++;
-#ifndef NDEBUG
-  if (sign < 0)
-    debug ("checking unsatisfiable core justified");
-  else
-    debug ("checking lemma is justified");
-#endif
-
-  debug ("assigning first all literals");
-  for (all_elements (int, lit, line.lits)) {
-    int signed_lit = sign * lit;
-    signed char value = values[signed_lit];
-    if (value < 0) {
-      debug ("skipping duplicated literal %s", debug_literal (signed_lit));
-      continue;
-    }
-    if (value > 0) {
-      debug ("found tautological literal %s and %s",
-             debug_literal (-signed_lit), debug_literal (signed_lit));
-      goto IMPLICATION_CHECK_SUCCEEDED;
-    }
-    assign (-signed_lit);
-  }
-
+  struct batch *batch = current_batch ();
+  batch->allocated = allocated;
+  for (all_elements (int, lit, line.lits))
+    PUSH (batch->lits, lit);
   for (all_elements (int64_t, id, line.ids)) {
+    struct antecedent antecedent = {0, id, VALID_ANTECEDENT};
     if (id < 0)
-      line_error (type, "negative antecedent %" PRId64 " unsupported", id);
-    struct clause *c = find_clause (&active, id);
-    if (!c) {
-      if (find_clause (&inactive, id))
-        line_error (type, "antecedent %" PRId64 " weakened", id);
-      else
-        line_error (type, "could not find antecedent %" PRId64, id);
-    }
-    statistics.resolutions++;
-    debug_clause (c, "resolving");
-    int unit = 0;
-    for (all_literals (lit, c)) {
-      signed char value = values[lit];
-      if (value < 0)
-        continue;
-      if (unit && unit != lit)
-        line_error (type, "antecedent %" PRId64 " not resolvable", id);
-      unit = lit;
-      if (!value)
-        assign (lit);
-    }
-    if (!unit) {
-      debug_clause (c, "justifying conflicting");
-      goto IMPLICATION_CHECK_SUCCEEDED;
-    }
+      antecedent.state = NEGATIVE_ANTECEDENT;
+    else if (!(antecedent.clause = find_clause (&clause_index, id)))
+      antecedent.state = MISSING_ANTECEDENT;
+    else if (clause_weakened (antecedent.clause))
+      antecedent.state = WEAKENED_ANTECEDENT;
+    PUSH (batch->antecedents, antecedent);
   }
+  struct queued_lemma lemma;
+  lemma.id = line.id;
+  lemma.lineno = file->start_of_line;
+  lemma.end_lits = SIZE (batch->lits);
+  lemma.end_antecedents = SIZE (batch->antecedents);
+  PUSH (batch->lemmas, lemma);
+  debug ("queued lemma %" PRId64 " in batch %zu", line.id,
+         pool.submitted + 1);
+  if (SIZE (batch->lemmas) == batch_size)
+    submit_batch ();
+}
 
-  line_error (type, "%s resolution check failed:", type_str);
-
-IMPLICATION_CHECK_SUCCEEDED:
+// Clauses deleted while lemmas are pending might still be needed as
+// antecedents and thus their memory can only be reused later.
 
-  backtrack ();
+static void free_or_defer_clause (struct clause *c) {
+  if (threads && pending_lemmas ()) {
+    size_t batch = pool.submitted;
+    if (pool.current && !EMPTY (pool.current->lemmas))
+      batch++;
+    struct deferred_clause deferred = {c, batch};
+    PUSH (pool.deferred, deferred);
+  } else
+    free_clause (c);
+}
 
-  debug ("%s resolution check succeeded", type_str);
-  (void) type_str;
+static void stop_workers (void) {
+  if (!threads)
+    return;
+  assert (!pending_lemmas ());
+  lock_pool ();
+  pool.terminate = true;
+  pthread_cond_broadcast (&pool.work);
+  unlock_pool ();
+  for (unsigned i = 0; i != threads; i++)
+    if (pthread_join (pool.workers[i], 0))
+      die ("failed to join worker thread %u", i);
+  free (pool.workers);
+  if (pool.current) {
+    pool.current->next = pool.recycled;
+    pool.recycled = pool.current;
+    pool.current = 0;
+  }
+  for (struct batch *batch = pool.recycled, *next; batch; batch = next) {
+    next = batch->next;
+    RELEASE (batch->lemmas);
+    RELEASE (batch->lits);
+    RELEASE (batch->antecedents);
+    free (batch);
+  }
+  RELEASE (pool.deferred);
 }
 
 /*------------------------------------------------------------------------*/
 
 // This section has all the low-level checks.
 
-static void check_unused (int type) {
+// Checks that the clause identifier of the line is not in use and
+// returns the slot reserved for the new clause in the clause index.
+
+static struct clause **check_unused (int type) {
   assert (line.id);
   if (no_reuse) {
     if (contains_bit (&used, line.id))
@@ -1526,42 +4039,80 @@ static void check_unused (int type) {
                   line.id);
     insert_bit (&used, line.id);
     debug ("clause identifier %" PRId64 " was never used", line.id);
-  } else {
-    if (find_clause (&active, line.id))
-      line_error (type, "clause identifier %" PRId64 " actively in use",
-                  line.id);
-    if (find_clause (&inactive, line.id))
-      line_error (type, "clause identifier %" PRId64 " inactive but in use",
-                  line.id);
-    debug ("clause identifier %" PRId64 " is not in use", line.id);
   }
+  struct clause **slot = find_or_new_slot (&clause_index, line.id);
+  if (*slot && clause_weakened (*slot))
+    line_error (type, "clause identifier %" PRId64 " inactive but in use",
+                line.id);
+  if (*slot)
+    line_error (type, "clause identifier %" PRId64 " actively in use",
+                line.id);
+  debug ("clause identifier %" PRId64 " is not in use", line.id);
+  return slot;
 }
 
-static void delete_clause (struct clause *c) {
-  assert (!c->weakened);
-  remove_clause (&active, c);
-  if (c->input)
-    debug_clause (c, "deleting but not freeing");
-  else
-    free_clause (c);
+static void delete_clause (int64_t id, struct clause *c) {
+  assert (!clause_weakened (c));
+  remove_clause (&clause_index, id);
+  remove_root_unit (id, c);
+  if (inlined (c))
+    debug_clause (c, "deleting");
+  else {
+    unwatch_clause (c);
+    if (c->input)
+      debug_clause (c, "deleting but not freeing");
+    else
+      free_or_defer_clause (c);
+  }
   statistics.deleted++;
 }
 
 static void weaken_clause (struct clause *c) {
   assert (!c->weakened);
   debug_clause (c, "weakening");
+  unwatch_clause (c);
+  remove_root_unit (c->id, c);
   c->weakened = true;
-  remove_clause (&active, c);
-  insert_clause (&inactive, c);
+  if (epoch_closed || EMPTY (epochs)) {
+    debug ("starting weakening epoch %zu", SIZE (epochs));
+    struct epoch epoch = {0, 0, 0};
+    PUSH (epochs, epoch);
+    epoch_closed = false;
+  }
+  struct epoch *e = epochs.end - 1;
+  c->epoch = e - epochs.begin;
+  struct clause *last = e->last;
+  c->prev_weakened = last;
+  c->next_weakened = 0;
+  if (last)
+    last->next_weakened = c;
+  else
+    e->first = c;
+  e->last = c;
+  e->count++;
   statistics.weakened++;
 }
 
 static void restore_clause (struct clause *c) {
   assert (c->weakened);
   debug_clause (c, "restoring");
-  remove_clause (&inactive, c);
-  insert_clause (&active, c);
+  assert (c->epoch < SIZE (epochs));
+  struct epoch *e = epochs.begin + c->epoch;
+  struct clause *prev = c->prev_weakened;
+  struct clause *next = c->next_weakened;
+  if (prev)
+    prev->next_weakened = next;
+  else
+    e->first = next;
+  if (next)
+    next->prev_weakened = prev;
+  else
+    e->last = prev;
+  assert (e->count);
+  e->count--;
   c->weakened = false;
+  watch_clause (c);
+  add_root_unit (c->id, c);
   statistics.restored++;
 }
 
@@ -1597,14 +4148,33 @@ static void check_line_consistent_with_saved (int type) {
   debug ("current and saved line have consistent literals");
 }
 
+static bool marked_literal_in_clause (struct clause *c) {
+  switch (c->width) {
+  case 1:
+    for (all_literals_of_width (int8_t, lit, c))
+      if (marks[lit])
+        return true;
+    break;
+  case 2:
+    for (all_literals_of_width (int16_t, lit, c))
+      if (marks[lit])
+        return true;
+    break;
+  default:
+    assert (c->width == 4);
+    for (all_literals_of_width (int, lit, c))
+      if (marks[lit])
+        return true;
+    break;
+  }
+  return false;
+}
+
 static void check_satisfied_clause (int type, struct clause *c) {
   if (c->tautological)
     return;
-  for (all_literals (lit, c)) {
-    assert (valid_literal (lit));
-    if (marks[lit])
-      return;
-  }
+  if (marked_literal_in_clause (c))
+    return;
   fflush (stdout);
   fprintf (stderr,
            "lidrup-check: error: model at line %zu in '%s' "
@@ -1612,8 +4182,8 @@ static void check_satisfied_clause (int type, struct clause *c) {
            file->start_of_line, file->name,
            c->input ? "input" : "derived"); // Defensive at this point!!!
   fputc (c->input ? 'i' : 'l', stderr);
-  for (all_literals (lit, c))
-    fprintf (stderr, " %d", lit);
+  for (unsigned i = 0; i != c->size; i++)
+    fprintf (stderr, " %d", get_literal (c, i));
   fputs (" 0\n", stderr);
   exit (1);
 }
@@ -1668,6 +4238,7 @@ static void start_query (void) {
 static void conclude_query (int res) {
   if (!querying)
     fatal_error ("query already concluded");
+  synchronize_lemma_checks ();
   if (verbosity > 0) {
     double current = wall_clock_time ();
     double delta = current - start_time;
@@ -1676,6 +4247,435 @@ static void conclude_query (int res) {
              statistics.queries, res, current, delta);
   }
   querying = false;
+  epoch_closed = true;
+  compact_clauses_if_fragmented ();
+}
+
+/*------------------------------------------------------------------------*/
+
+// With '--backward' lemmas are not checked when they are added.  Instead
+// their literals and antecedents are recorded in a lemma log.  Before an
+// unsatisfiable core is checked, all logged lemmas reachable from its
+// antecedents are marked and only those are checked.  Lemmas not needed
+// by any core are skipped.  Antecedents are resolved to input clauses or
+// logged lemmas when the lemma is logged, in the same way as 'queue_lemma'
+// determines antecedents.  A lemma check only depends on the logged
+// literals of the lemma and its antecedents.  Thus lemmas can be checked
+// in any order and also after their antecedents have been deleted, since
+// the log keeps all lemmas.  Marked lemmas are still checked in the order
+// they were added though in order to report the first failing lemma.
+// In order to keep the log small, antecedent ids are not logged but
+// retrieved from the referenced clause or lemma if needed.  Only the ids
+// of invalid antecedents are kept separately.
+
+enum lemma_status {
+  UNMARKED_LEMMA = 0,
+  MARKED_LEMMA = 1,
+  CHECKED_LEMMA = 2,
+};
+
+struct logged_lemma {
+  int64_t id;
+  size_t lineno;
+  size_t end_lits;        // End of literals in 'lemma_log.lits'.
+  size_t end_antecedents; // End of antecedents in 'lemma_log.antecedents'.
+  int status;
+};
+
+struct logged_lemmas {
+  struct logged_lemma *begin, *end, *allocated;
+};
+
+struct logged_antecedent {
+  unsigned position;   // Of input clause, logged lemma or invalid id.
+  unsigned char state; // Determined when logged (see 'antecedent_state').
+  bool input;          // Input clause and not a logged lemma.
+};
+
+struct logged_antecedents {
+  struct logged_antecedent *begin, *end, *allocated;
+};
+
+static struct {
+  struct logged_lemmas lemmas;
+  struct lits lits;
+  struct logged_antecedents antecedents;
+  struct ids invalid;         // Ids of invalid antecedents.
+  struct positions marked;    // Marked but not yet checked lemmas.
+  struct positions scheduled; // Marked lemmas sorted for checking.
+} lemma_log;
+
+static unsigned log_lemma (void) {
+  const size_t position = SIZE (lemma_log.lemmas);
+  if (position > UINT_MAX)
+    parse_error ("maximum number of logged lemmas exhausted");
+  for (all_elements (int, lit, line.lits))
+    PUSH (lemma_log.lits, lit);
+  for (all_elements (int64_t, id, line.ids)) {
+    struct logged_antecedent antecedent = {0, VALID_ANTECEDENT, false};
+    struct clause *c = id > 0 ? find_clause (&clause_index, id) : 0;
+    if (id < 0)
+      antecedent.state = NEGATIVE_ANTECEDENT;
+    else if (!c)
+      antecedent.state = MISSING_ANTECEDENT;
+    else if (clause_weakened (c))
+      antecedent.state = WEAKENED_ANTECEDENT;
+    else {
+      assert (!inlined (c));
+      antecedent.position = c->position;
+      antecedent.input = c->input;
+    }
+    if (antecedent.state != VALID_ANTECEDENT) {
+      if (SIZE (lemma_log.invalid) > UINT_MAX)
+        parse_error ("maximum number of invalid antecedents exhausted");
+      antecedent.position = SIZE (lemma_log.invalid);
+      PUSH (lemma_log.invalid, id);
+    }
+    PUSH (lemma_log.antecedents, antecedent);
+  }
+  struct logged_lemma lemma;
+  lemma.id = line.id;
+  lemma.lineno = file->start_of_line;
+  lemma.end_lits = SIZE (lemma_log.lits);
+  lemma.end_antecedents = SIZE (lemma_log.antecedents);
+  lemma.status = UNMARKED_LEMMA;
+  PUSH (lemma_log.lemmas, lemma);
+  debug ("logged lemma %" PRId64 " at position %zu", line.id, position);
+  statistics.skipped++;
+  return position;
+}
+
+static void mark_logged_lemma (unsigned position) {
+  struct logged_lemma *lemma = lemma_log.lemmas.begin + position;
+  if (lemma->status != UNMARKED_LEMMA)
+    return;
+  lemma->status = MARKED_LEMMA;
+  PUSH (lemma_log.marked, position);
+}
+
+static int64_t logged_antecedent_id (struct logged_antecedent *a) {
+  if (a->state != VALID_ANTECEDENT)
+    return PEEK (lemma_log.invalid, a->position);
+  if (a->input)
+    return PEEK (input_clauses, a->position)->id;
+  return PEEK (lemma_log.lemmas, a->position).id;
+}
+
+static void print_logged_lemma (unsigned position) {
+  struct logged_lemma *lemma = lemma_log.lemmas.begin + position;
+  size_t begin_lits = 0, begin_antecedents = 0;
+  if (position) {
+    begin_lits = lemma[-1].end_lits;
+    begin_antecedents = lemma[-1].end_antecedents;
+  }
+  fprintf (stderr, "l %" PRId64, lemma->id);
+  for (size_t i = begin_lits; i != lemma->end_lits; i++)
+    fprintf (stderr, " %d", lemma_log.lits.begin[i]);
+  fputs (" 0", stderr);
+  for (size_t i = begin_antecedents; i != lemma->end_antecedents; i++)
+    fprintf (stderr, " %" PRId64,
+             logged_antecedent_id (lemma_log.antecedents.begin + i));
+  fputs (" 0\n", stderr);
+}
+
+static void report_failed_logged_lemma (unsigned position, int failure,
+                                        struct logged_antecedent *culprit) {
+  struct logged_lemma *lemma = lemma_log.lemmas.begin + position;
+  int state = culprit ? culprit->state : VALID_ANTECEDENT;
+  int64_t id = culprit ? logged_antecedent_id (culprit) : 0;
+  print_lemma_check_failure (lemma->lineno, failure, state, id);
+  print_logged_lemma (position);
+  exit (1);
+}
+
+// Same as 'resolve_antecedent' but for literals of logged lemmas.
+
+static bool resolve_logged_lemma (unsigned position, int *unit_ptr) {
+  struct logged_lemma *lemma = lemma_log.lemmas.begin + position;
+  const int *lits = lemma_log.lits.begin;
+  const int *p = position ? lits + lemma[-1].end_lits : lits;
+  const int *end = lits + lemma->end_lits;
+  int unit = 0;
+  while (p != end)
+    if (!resolve_literal (*p++, &unit))
+      return false;
+  *unit_ptr = unit;
+  return true;
+}
+
+static void check_logged_lemma (unsigned position) {
+  struct logged_lemma *lemma = lemma_log.lemmas.begin + position;
+  assert (lemma->status == MARKED_LEMMA);
+  debug ("checking logged lemma %" PRId64 " at position %u", lemma->id,
+         position);
+  statistics.checks++;
+  size_t begin_lits = 0, begin_antecedents = 0;
+  if (position) {
+    begin_lits = lemma[-1].end_lits;
+    begin_antecedents = lemma[-1].end_antecedents;
+  }
+  int failure = RESOLUTION_FAILURE;
+  struct logged_antecedent *culprit = 0;
+  const int *lits = lemma_log.lits.begin;
+  for (size_t i = begin_lits; i != lemma->end_lits; i++) {
+    int lit = lits[i];
+    signed char value = values[lit];
+    if (value < 0)
+      continue;
+    if (value > 0)
+      goto LOGGED_LEMMA_CHECK_SUCCEEDED;
+    assign (-lit);
+  }
+  struct logged_antecedent *antecedents = lemma_log.antecedents.begin;
+  for (size_t i = begin_antecedents; i != lemma->end_antecedents; i++) {
+    struct logged_antecedent *antecedent = antecedents + i;
+    if (antecedent->state != VALID_ANTECEDENT) {
+      failure = ANTECEDENT_FAILURE;
+      culprit = antecedent;
+      break;
+    }
+    statistics.resolutions++;
+    int unit;
+    bool resolved;
+    if (antecedent->input) {
+      struct clause *c = PEEK (input_clauses, antecedent->position);
+      debug_clause (c, "resolving");
+      resolved = resolve_antecedent (c, &unit);
+    } else
+      resolved = resolve_logged_lemma (antecedent->position, &unit);
+    if (!resolved) {
+      failure = NOT_RESOLVABLE_FAILURE;
+      culprit = antecedent;
+      break;
+    }
+    if (!unit)
+      goto LOGGED_LEMMA_CHECK_SUCCEEDED;
+  }
+  report_failed_logged_lemma (position, failure, culprit);
+
+LOGGED_LEMMA_CHECK_SUCCEEDED:
+
+  backtrack ();
+  lemma->status = CHECKED_LEMMA;
+  assert (statistics.skipped);
+  statistics.skipped--;
+}
+
+static int cmp_positions (const void *p, const void *q) {
+  unsigned a = *(const unsigned *) p, b = *(const unsigned *) q;
+  return (a > b) - (a < b);
+}
+
+// Checks all logged lemmas reachable from the antecedents of the current
+// core line, which is then checked by 'check_implied' as before.
+
+static void check_logged_lemmas_needed_by_core (void) {
+  if (!backward)
+    return;
+  assert (EMPTY (lemma_log.marked));
+  for (all_elements (int64_t, id, line.ids)) {
+    struct clause *c = id > 0 ? find_clause (&clause_index, id) : 0;
+    if (c && !c->input && !clause_weakened (c))
+      mark_logged_lemma (c->position);
+  }
+  CLEAR (lemma_log.scheduled);
+  while (!EMPTY (lemma_log.marked)) {
+    unsigned position = *--lemma_log.marked.end;
+    PUSH (lemma_log.scheduled, position);
+    struct logged_lemma *lemma = lemma_log.lemmas.begin + position;
+    size_t i = position ? lemma[-1].end_antecedents : 0;
+    while (i != lemma->end_antecedents) {
+      struct logged_antecedent *antecedent =
+          lemma_log.antecedents.begin + i++;
+      if (antecedent->state == VALID_ANTECEDENT && !antecedent->input)
+        mark_logged_lemma (antecedent->position);
+    }
+  }
+  qsort (lemma_log.scheduled.begin, SIZE (lemma_log.scheduled),
+         sizeof *lemma_log.scheduled.begin, cmp_positions);
+  verbose ("checking %zu logged lemmas needed by core",
+           SIZE (lemma_log.scheduled));
+  for (all_elements (unsigned, position, lemma_log.scheduled))
+    check_logged_lemma (position);
+}
+
+static void release_lemma_log (void) {
+  RELEASE (lemma_log.lemmas);
+  RELEASE (lemma_log.lits);
+  RELEASE (lemma_log.antecedents);
+  RELEASE (lemma_log.invalid);
+  RELEASE (lemma_log.marked);
+  RELEASE (lemma_log.scheduled);
+}
+
+/*------------------------------------------------------------------------*/
+
+// Non-linear IDRUP proofs (with 'p idrup' header or '--idrup') have
+// neither clause identifiers nor antecedents.  Lemmas and cores are then
+// checked by unit propagation alone (see '--propagate').  Added clauses
+// still get fresh internal identifiers and are kept in the clause index
+// as for linear proofs.  However, deleted, weakened and restored clauses
+// are given by their literals.  In order to find them, clauses are stored
+// with sorted literals and the literal index maps the hash of the sorted
+// literals to the internal identifiers of clauses with these literals.
+// The literal index uses open addressing with linear probing too.
+
+struct literal_entry {
+  uint64_t hash;
+  int64_t id; // Zero for empty entries.
+};
+
+static struct {
+  struct literal_entry *table;
+  size_t size, count;
+} literal_index;
+
+static int64_t idrup_ids;  // Last internal clause identifier.
+static struct lits sorted; // Sorted literals of the current line.
+
+static int cmp_literals (const void *p, const void *q) {
+  int a = *(const int *) p, b = *(const int *) q;
+  return (a > b) - (a < b);
+}
+
+static uint64_t hash_literal (uint64_t hash, int lit) {
+  return (hash + (unsigned) lit) * 0x9e3779b97f4a7c15u;
+}
+
+static uint64_t hash_sorted_literals (void) {
+  uint64_t hash = SIZE (sorted);
+  for (all_elements (int, lit, sorted))
+    hash = hash_literal (hash, lit);
+  return hash ^ (hash >> 32);
+}
+
+static uint64_t hash_clause_literals (struct clause *c) {
+  uint64_t hash = c->size;
+  for (unsigned i = 0; i != c->size; i++)
+    hash = hash_literal (hash, get_literal (c, i));
+  return hash ^ (hash >> 32);
+}
+
+static void resize_literal_index (size_t new_size) {
+  const size_t old_size = literal_index.size;
+  struct literal_entry *old_table = literal_index.table;
+  struct literal_entry *new_table = calloc (new_size, sizeof *new_table);
+  if (!new_table)
+    out_of_memory ("allocating literal index of size %zu", new_size);
+  const size_t mask = new_size - 1;
+  for (size_t i = 0; i != old_size; i++) {
+    struct literal_entry entry = old_table[i];
+    if (!entry.id)
+      continue;
+    size_t pos = entry.hash & mask;
+    while (new_table[pos].id)
+      pos = (pos + 1) & mask;
+    new_table[pos] = entry;
+  }
+  free (old_table);
+  literal_index.table = new_table;
+  literal_index.size = new_size;
+}
+
+static void insert_literal_index (struct clause *c) {
+  const size_t size = literal_index.size;
+  if (2 * (literal_index.count + 1) > size)
+    resize_literal_index (size ? 2 * size : min_hash_table_size);
+  const size_t mask = literal_index.size - 1;
+  const uint64_t hash = hash_clause_literals (c);
+  size_t pos = hash & mask;
+  while (literal_index.table[pos].id)
+    pos = (pos + 1) & mask;
+  literal_index.table[pos].hash = hash;
+  literal_index.table[pos].id = c->id;
+  literal_index.count++;
+}
+
+static void remove_literal_index (size_t pos) {
+  const size_t mask = literal_index.size - 1;
+  struct literal_entry *table = literal_index.table;
+  assert (table[pos].id);
+  for (size_t next = (pos + 1) & mask; table[next].id;
+       next = (next + 1) & mask) {
+    size_t home = table[next].hash & mask;
+    if (((next - home) & mask) < ((next - pos) & mask))
+      continue;
+    table[pos] = table[next];
+    pos = next;
+  }
+  table[pos].id = 0;
+  assert (literal_index.count);
+  literal_index.count--;
+}
+
+static bool clause_has_sorted_literals (struct clause *c) {
+  if (c->size != SIZE (sorted))
+    return false;
+  for (unsigned i = 0; i != c->size; i++)
+    if (get_literal (c, i) != sorted.begin[i])
+      return false;
+  return true;
+}
+
+// Returns the position in the literal index of an active respectively
+// weakened clause with the literals of the current line (as multiset).
+// If there is no such clause the size of the literal index is returned.
+
+static size_t find_literal_index (bool weakened) {
+  CLEAR (sorted);
+  for (all_elements (int, lit, line.lits))
+    PUSH (sorted, lit);
+  qsort (sorted.begin, SIZE (sorted), sizeof *sorted.begin, cmp_literals);
+  const size_t size = literal_index.size;
+  if (!size)
+    return size;
+  const size_t mask = size - 1;
+  const uint64_t hash = hash_sorted_literals ();
+  struct literal_entry *table = literal_index.table;
+  for (size_t pos = hash & mask; table[pos].id; pos = (pos + 1) & mask) {
+    if (table[pos].hash != hash)
+      continue;
+    struct clause *c = find_clause (&clause_index, table[pos].id);
+    assert (c);
+    if (clause_weakened (c) == weakened && clause_has_sorted_literals (c))
+      return pos;
+  }
+  return size;
+}
+
+// Added clauses get the next internal identifier and sorted literals.
+
+static struct clause **new_idrup_slot (void) {
+  assert (!line.id);
+  line.id = ++idrup_ids;
+  qsort (line.lits.begin, SIZE (line.lits), sizeof *line.lits.begin,
+         cmp_literals);
+  struct clause **slot = find_or_new_slot (&clause_index, line.id);
+  assert (!*slot);
+  return slot;
+}
+
+static void find_then_delete_idrup_clause (int type) {
+  size_t pos = find_literal_index (false);
+  if (pos == literal_index.size)
+    line_error (type, "could not find and delete clause");
+  int64_t id = literal_index.table[pos].id;
+  remove_literal_index (pos);
+  delete_clause (id, find_clause (&clause_index, id));
+}
+
+static void find_then_weaken_idrup_clause (int type) {
+  size_t pos = find_literal_index (false);
+  if (pos == literal_index.size)
+    line_error (type, "could not find and weaken clause");
+  weaken_clause (find_clause (&clause_index, literal_index.table[pos].id));
+}
+
+static void find_then_restore_idrup_clause (int type) {
+  size_t pos = find_literal_index (true);
+  if (pos == literal_index.size)
+    line_error (type, "could not find and restore weakened clause");
+  restore_clause (find_clause (&clause_index, literal_index.table[pos].id));
 }
 
 /*------------------------------------------------------------------------*/
@@ -1683,41 +4683,61 @@ static void conclude_query (int res) {
 // Merged checking options for each line.
 
 static void add_input_clause (int type) {
-  check_unused (type);
+  struct clause **slot = idrup ? new_idrup_slot () : check_unused (type);
   struct clause *c = allocate_clause (true);
-  insert_clause (&active, c);
+  debug_clause (c, "inserting in clause index");
+  *slot = c;
+  watch_clause (c);
+  if (idrup)
+    insert_literal_index (c);
+  add_root_unit (line.id, c);
   statistics.inputs++;
   (void) type;
 }
 
 static void check_then_add_lemma (int type) {
-  check_unused (type);
-  check_implied (type, "lemma", 1);
-  struct clause *c = allocate_clause (false);
-  insert_clause (&active, c);
+  struct clause **slot = idrup ? 0 : check_unused (type);
+  if (threads)
+    queue_lemma ();
+  else if (!backward)
+    check_implied (type, "lemma", 1);
+  if (idrup)
+    slot = new_idrup_slot ();
+  struct clause *c = new_lemma ();
+  if (backward)
+    c->position = log_lemma ();
+  debug_clause (c, "inserting in clause index");
+  *slot = c;
+  watch_clause (c);
+  if (idrup)
+    insert_literal_index (c);
+  add_root_unit (line.id, c);
   statistics.lemmas++;
   (void) type;
 }
 
 static void find_then_delete_clause (int type, int64_t id) {
-  struct clause *c = find_clause (&active, id);
-  if (c)
-    delete_clause (c);
+  struct clause *c = find_clause (&clause_index, id);
+  if (c && !clause_weakened (c))
+    delete_clause (id, c);
   else
     line_error (type, "could not find and delete clause %" PRId64, id);
 }
 
 static void find_then_weaken_clause (int type, int64_t id) {
-  struct clause *c = find_clause (&active, id);
-  if (c)
+  struct clause **slot = find_slot (&clause_index, id);
+  struct clause *c = slot ? *slot : 0;
+  if (c && inlined (c))
+    *slot = c = uninline_clause (id, c);
+  if (c && !c->weakened)
     weaken_clause (c);
   else
     line_error (type, "could not find and weaken clause %" PRId64, id);
 }
 
 static void find_then_restore_clause (int type, int64_t id) {
-  struct clause *c = find_clause (&inactive, id);
-  if (c)
+  struct clause *c = find_clause (&clause_index, id);
+  if (c && clause_weakened (c))
     restore_clause (c);
   else
     line_error (type, "could not find and restore weakened clause %" PRId64,
@@ -1726,20 +4746,69 @@ static void find_then_restore_clause (int type, int64_t id) {
 
 static void find_then_delete_clauses (int type) {
   assert (type == 'd');
-  for (all_elements (int64_t, id, line.ids))
-    find_then_delete_clause (type, id);
+  if (idrup)
+    find_then_delete_idrup_clause (type);
+  else
+    for (all_elements (int64_t, id, line.ids))
+      find_then_delete_clause (type, id);
+  compact_clauses_if_fragmented ();
 }
 
 static void find_then_weaken_clauses (int type) {
   assert (type == 'w');
-  for (all_elements (int64_t, id, line.ids))
-    find_then_weaken_clause (type, id);
+  if (idrup)
+    find_then_weaken_idrup_clause (type);
+  else
+    for (all_elements (int64_t, id, line.ids))
+      find_then_weaken_clause (type, id);
+}
+
+// Fast path for 'r' lines which restore exactly the clauses of the last
+// epochs in the order they were weakened.  Then comparing the identifiers
+// of the line with those on the epoch lists is enough to check that all
+// are weakened, without searching for them in the clause index.  If this
+// comparison fails nothing is changed and the caller falls back to
+// restoring clauses one by one.
+
+static bool restore_epochs (void) {
+  const size_t size = SIZE (line.ids);
+  struct epoch *begin = epochs.end;
+  size_t count = 0;
+  while (count < size && begin != epochs.begin)
+    count += (--begin)->count;
+  if (!size || count != size)
+    return false;
+  const int64_t *p = line.ids.begin;
+  for (struct epoch *e = begin; e != epochs.end; e++)
+    for (struct clause *c = e->first; c; c = c->next_weakened)
+      if (c->id != *p++)
+        return false;
+  debug ("restoring %zu clauses of the last %zu epochs", size,
+         (size_t) (epochs.end - begin));
+  for (struct epoch *e = begin; e != epochs.end; e++)
+    for (struct clause *c = e->first; c; c = c->next_weakened) {
+      assert (c->weakened);
+      debug_clause (c, "restoring");
+      c->weakened = false;
+      watch_clause (c);
+      add_root_unit (c->id, c);
+    }
+  epochs.end = begin;
+  statistics.bulk_restored += size;
+  statistics.restored += size;
+  return true;
 }
 
 static void find_then_restore_clauses (int type) {
   assert (type == 'r');
-  for (all_elements (int64_t, id, line.ids))
-    find_then_restore_clause (type, id);
+  if (idrup)
+    find_then_restore_idrup_clause (type);
+  else if (!restore_epochs ())
+    for (all_elements (int64_t, id, line.ids))
+      find_then_restore_clause (type, id);
+  while (!EMPTY (epochs) && !epochs.end[-1].count)
+    epochs.end--;
+  epoch_closed = true;
 }
 
 static bool is_input_learn_delete_restore_or_weaken (int type) {
@@ -1778,15 +4847,113 @@ static void save_line (int type) {
   saved_type = type;
 }
 
+// Allocating tables according to the size hints in the header, where the
+// hash table is kept at most half full and the used bit table is only
+// needed with '--no-reuse'.  For dense clause identifiers we only need
+// to allocate the array of directly indexed pages instead of the hash
+// table.  Hints only ever enlarge tables.  As every clause and variable
+// takes at least a few bytes in the files, hints are capped by the size
+// of the files (or 'max_unknown_hint' if a file is a pipe).  If the
+// capped tables can still not be allocated presizing is skipped.
+
+#define min_hint_limit ((int64_t) 1 << 16)
+#define max_unknown_hint ((int64_t) 1 << 24)
+
+static int64_t hint_limit (void) {
+  int64_t bytes = 0;
+  for (int i = 0; i != num_files; i++) {
+    struct stat buf;
+    if (!files[i].file || fstat (fileno (files[i].file), &buf) ||
+        !S_ISREG (buf.st_mode) || follow || files[i].decompressor)
+      return max_unknown_hint;
+    bytes += buf.st_size;
+  }
+  int64_t res = bytes / 2;
+  return res < min_hint_limit ? min_hint_limit : res;
+}
+
+static void presize (void) {
+  int64_t variables = hints[VARIABLES_HINT];
+  int64_t clauses = hints[CLAUSES_HINT];
+  int64_t identifiers = hints[IDENTIFIERS_HINT];
+  if (!variables && !clauses && !identifiers)
+    return;
+  verbose ("size hints %" PRId64 " variables %" PRId64
+           " clauses %" PRId64 " identifiers",
+           variables, clauses, identifiers);
+  const int64_t limit = hint_limit ();
+  if (variables > limit)
+    variables = limit;
+  if (clauses > limit)
+    clauses = limit;
+  bool dense = identifiers && identifiers <= 2 * clauses;
+  if (!dense && identifiers > 64 * limit)
+    identifiers = 64 * limit;
+  size_t pages = (identifiers >> id_page_bits) + 1;
+  size_t size = 1;
+  while (size <= 2 * (size_t) clauses)
+    size *= 2;
+  size_t words = (identifiers >> 6) + 1;
+  size_t bytes = 0;
+  if ((size_t) variables >= allocated)
+    bytes += 2 * (size_t) variables * (2 * sizeof *values + sizeof (int));
+  if (dense)
+    bytes += pages * sizeof (struct id_page *);
+  else if (clauses)
+    bytes += size * (sizeof (int64_t) + sizeof (struct clause *));
+  if (no_reuse && identifiers)
+    bytes += words * sizeof (uint64_t);
+  void *probe = malloc (bytes);
+  if (!probe) {
+    verbose ("ignoring size hints (could not allocate %zu bytes)", bytes);
+    return;
+  }
+  free (probe);
+  if ((size_t) variables >= allocated)
+    increase_allocated (variables);
+  if (dense) {
+    if (pages > clause_index.num_pages)
+      enlarge_pages (&clause_index, pages);
+  } else if (clauses && size > clause_index.size) {
+    resize_hash_table (&clause_index, size);
+    clause_index.reserved = size;
+  }
+  if (no_reuse && identifiers && words > used.size)
+    enlarge_bit_table (&used, words);
+}
+
+// The mode is switched when a 'p idrup' header is found at the start of
+// the proof, before any clause is added.
+
+static void start_idrup_mode (void) {
+  if (threads)
+    parse_error ("can not check IDRUP proof with '--threads'");
+  if (backward)
+    parse_error ("can not check IDRUP proof with '--backward'");
+  verbose ("checking non-linear IDRUP proof");
+  idrup = propagate = true;
+  if (allocated && !watches) {
+    watches = calloc (2 * allocated, sizeof *watches);
+    if (!watches)
+      out_of_memory ("allocating watches of size %zu", allocated);
+    watches += allocated;
+  }
+}
+
 static bool match_header (const char *expected) {
   if (file->lines > 1)
     return false;
   assert (file->lines == 1);
+  if (expected == LIDRUP && string == IDRUP && !idrup)
+    start_idrup_mode ();
+  if (expected == LIDRUP && idrup)
+    expected = IDRUP;
   if (string != expected)
     parse_error ("expected '%s' header and not 'p %s' "
                  "(input files swapped?)",
                  expected, string);
   verbose ("found '%s' header in '%s'", string, file->name);
+  presize ();
   return true;
 }
 
@@ -1874,6 +5041,8 @@ static void conclude_unsatisfiable_query_with_core (int type) {
       check_saved_failed_literals_match_core (type);
     }
   }
+  synchronize_lemma_checks ();
+  check_logged_lemmas_needed_by_core ();
   check_implied (type, "unsatisfiable core", -1);
   statistics.conclusions++;
   statistics.cores++;
@@ -2334,36 +5503,23 @@ static int parse_and_check_idrup (void) {
 // memory leaks reclaiming all memory before successfully exiting the
 // checker is thus not only good style.  Reclaiming all memory combined
 // with memory checkers, e.g., 'configure -a' to compile with ASAN,
-// allows to check for memory leaks.  For the linear clause checker we
-// use two hash tables to map clause identifiers to clauses, one for
-// active and one for inactive clauses.  We traverse those hash tables
-// to properly reclaim clauses.
-
-static void release_clauses_in_hash_table (struct hash_table *hash_table) {
-  struct clause **table = hash_table->table;
-  struct clause **end = table + hash_table->size;
-  for (struct clause **p = table; p != end; p++) {
-    struct clause *c = *p;
-    if (VALID (c) && !c->input)
-      free_clause (c);
-  }
-}
-
-static void release_active_clauses (void) {
-  debug ("releasing active clauses");
-  release_clauses_in_hash_table (&active);
-}
-
-static void release_inactive_clauses (void) {
-  debug ("releasing inactive clauses");
-  release_clauses_in_hash_table (&inactive);
+// allows to check for memory leaks.  As all clauses live in arenas and
+// large clause blocks we do not have to traverse the hash tables to find
+// and reclaim clauses but simply free those blocks.
+
+static void release_clauses (void) {
+  debug ("releasing clauses");
+  release_blocks (clause_store.arenas);
+  release_blocks (clause_store.large);
+  RELEASE (input_clauses);
 }
 
-static void release_input_clauses (void) {
-  debug ("releasing input clauses");
-  for (all_pointers (struct clause, c, input_clauses))
-    free_clause (c);
-  RELEASE (input_clauses);
+static void release_hash_table (struct hash_table *hash_table) {
+  for (size_t i = 0; i != hash_table->num_pages; i++)
+    free (hash_table->pages[i]);
+  free (hash_table->pages);
+  free (hash_table->keys);
+  free (hash_table->table);
 }
 
 static void release (void) {
@@ -2371,13 +5527,18 @@ static void release (void) {
   RELEASE (line.ids);
   RELEASE (saved);
   RELEASE (query);
-  release_active_clauses ();
-  release_inactive_clauses ();
-  release_input_clauses ();
+  release_clauses ();
   if (no_reuse && used.words)
     free (used.words);
-  free (active.table);
-  free (inactive.table);
+  release_hash_table (&clause_index);
+  RELEASE (epochs);
+  RELEASE (antecedents);
+  release_lemma_log ();
+  release_watchers ();
+  RELEASE (root.units);
+  RELEASE (root.cited);
+  free (literal_index.table);
+  RELEASE (sorted);
   free (trail.begin);
   values -= allocated;
   free (values);
@@ -2393,16 +5554,31 @@ static void print_statistics (void) {
   double w = wall_clock_time ();
   printf ("c %-20s %20zu %12.2f per variable\n", "added:", statistics.added,
           average (statistics.added, statistics.imported));
+  printf ("c %-20s %20zu %12.2f %% restored\n",
+          "bulk-restored:", statistics.bulk_restored,
+          percent (statistics.bulk_restored, statistics.restored));
   printf ("c %-20s %20zu %12.2f %% queries\n",
           "conclusions:", statistics.conclusions,
           percent (statistics.conclusions, statistics.queries));
   printf ("c %-20s %20zu %12.2f %% conclusions\n",
           "cores:", statistics.cores,
           percent (statistics.cores, statistics.conclusions));
+  printf ("c %-20s %20zu %12.2f %% checks\n",
+          "chained:", statistics.chained,
+          percent (statistics.chained, statistics.checks));
   printf ("c %-20s %20zu %12.2f %% lemmas\n", "checks:", statistics.checks,
           percent (statistics.lemmas, statistics.checks));
+  printf ("c %-20s %20zu %12.2f %% checks\n",
+          "cleared:", statistics.cleared,
+          percent (statistics.cleared, statistics.checks));
+  printf ("c %-20s %20zu %12.2f %% queries\n",
+          "compactions:", statistics.compactions,
+          percent (statistics.compactions, statistics.queries));
   printf ("c %-20s %20zu %12.2f %% added\n", "deleted:", statistics.deleted,
           percent (statistics.deleted, statistics.added));
+  printf ("c %-20s %20zu %12.2f %% lemmas\n",
+          "inlined:", statistics.inlined,
+          percent (statistics.inlined, statistics.lemmas));
   printf ("c %-20s %20zu %12.2f %% added\n", "inputs:", statistics.inputs,
           percent (statistics.inputs, statistics.added));
   printf ("c %-20s %20zu %12.2f %% added\n", "lemmas:", statistics.lemmas,
@@ -2410,14 +5586,35 @@ static void print_statistics (void) {
   printf ("c %-20s %20zu %12.2f %% conclusions\n",
           "models:", statistics.models,
           percent (statistics.models, statistics.conclusions));
+  printf ("c %-20s %20zu %12.2f %% checks\n",
+          "propagated:", statistics.propagated,
+          percent (statistics.propagated, statistics.checks));
+  printf ("c %-20s %20zu %12.2f per propagated\n",
+          "propagations:", statistics.propagations,
+          average (statistics.propagations, statistics.propagated));
+  printf ("c %-20s %20zu %12.2f %% propagated\n",
+          "rebuilds:", statistics.rebuilds,
+          percent (statistics.rebuilds, statistics.propagated));
   printf ("c %-20s %20zu %12.2f per check\n",
           "resolutions:", statistics.resolutions,
           average (statistics.resolutions, statistics.checks));
   printf ("c %-20s %20zu %12.2f per second\n",
           "queries:", statistics.queries, average (w, statistics.queries));
+  printf ("c %-20s %20zu %12.2f %% added\n",
+          "recycled:", statistics.recycled,
+          percent (statistics.recycled, statistics.added));
+  printf ("c %-20s %20zu %12.2f %% checks\n",
+          "resets:", statistics.resets,
+          percent (statistics.resets, statistics.checks));
   printf ("c %-20s %20zu %12.2f %% weakened\n",
           "restored:", statistics.restored,
           percent (statistics.restored, statistics.weakened));
+  printf ("c %-20s %20zu %12.2f %% lemmas\n",
+          "skipped:", statistics.skipped,
+          percent (statistics.skipped, statistics.lemmas));
+  printf ("c %-20s %20zu %12.2f %% resolutions\n",
+          "units:", statistics.units,
+          percent (statistics.units, statistics.resolutions));
   printf ("c %-20s %20zu %12.2f %% inputs\n",
           "weakened:", statistics.weakened,
           percent (statistics.weakened, statistics.inputs));
@@ -2484,6 +5681,25 @@ static void init_signals (void) {
 
 /*------------------------------------------------------------------------*/
 
+// Parses the argument of numerical options such as '--threads <n>'.
+
+static size_t parse_number_argument (const char *option, const char *arg,
+                                     size_t max) {
+  if (!arg)
+    die ("argument to '%s' missing (try '-h')", option);
+  if (!*arg)
+    die ("invalid empty argument to '%s' (try '-h')", option);
+  size_t res = 0;
+  for (const char *p = arg; *p; p++) {
+    if (!ISDIGIT (*p))
+      die ("invalid argument '%s' to '%s' (try '-h')", arg, option);
+    if ((res = 10 * res + (*p - '0')) > max)
+      die ("argument '%s' to '%s' too large (maximum %zu)", arg, option,
+           max);
+  }
+  return res;
+}
+
 int main (int argc, char **argv) {
 
   start_of_wall_clock_time = absolute_wall_clock_time ();
@@ -2513,7 +5729,23 @@ int main (int argc, char **argv) {
       mode = relaxed;
     else if (!strcmp (arg, "--pedantic"))
       mode = pedantic;
-    else if (arg[0] == '-')
+    else if (!strcmp (arg, "--backward"))
+      backward = true;
+    else if (!strcmp (arg, "--follow"))
+      follow = true;
+    else if (!strcmp (arg, "--follow-timeout")) {
+      follow_timeout =
+          parse_number_argument (arg, argv[++i], max_follow_timeout);
+      follow = true;
+    } else if (!strcmp (arg, "--compact"))
+      compact_bytes = parse_number_argument (arg, argv[++i], MAX_HINT);
+    else if (!strcmp (arg, "--propagate"))
+      propagate = true;
+    else if (!strcmp (arg, "--idrup"))
+      idrup = true;
+    else if (!strcmp (arg, "--threads"))
+      threads = parse_number_argument (arg, argv[++i], max_threads);
+    else if (arg[0] == '-' && arg[1])
       die ("invalid command line option '%s' (try '-h')", arg);
     else if (num_files < 2)
       files[num_files++].name = arg;
@@ -2525,15 +5757,32 @@ int main (int argc, char **argv) {
   if (!num_files)
     die ("no file given but expected two (try '-h')");
 
+  if (backward && threads)
+    die ("can not combine '--backward' and '--threads'");
+  if (propagate && threads)
+    die ("can not combine '--propagate' and '--threads'");
+  if (propagate && backward)
+    die ("can not combine '--propagate' and '--backward'");
+  if (idrup && threads)
+    die ("can not combine '--idrup' and '--threads'");
+  if (idrup && backward)
+    die ("can not combine '--idrup' and '--backward'");
+  if (idrup)
+    propagate = true;
+
+  if (num_files == 2 && !strcmp (files[0].name, "-") &&
+      !strcmp (files[1].name, "-"))
+    die ("can not read both files from '<stdin>'");
+
   if (num_files == 2) {
     interactions = files;
     proof = interactions + 1;
-    if (!(files[0].file = fopen (files[0].name, "r")))
+    if (!open_file (files))
       die ("can not read incremental CNF file '%s'", files[0].name);
   } else
     proof = files;
 
-  if (!(proof->file = fopen (proof->name, "r")))
+  if (!open_file (proof))
     die ("can not read incremental DRUP proof file '%s'", proof->name);
 
   message ("Interaction DRUP Checker");
@@ -2558,6 +5807,19 @@ int main (int argc, char **argv) {
   if (interactions)
     message ("reading incremental CNF '%s'", interactions->name);
   message ("reading and checking incremental DRUP proof '%s'", proof->name);
+  for (int i = 0; i != num_files; i++)
+    if (files[i].decompressor)
+      message ("decompressing '%s' with '%s'", files[i].name,
+               files[i].decompressor);
+
+  if (threads)
+    start_workers ();
+  else if (backward)
+    message ("backward checking only lemmas needed by cores");
+  else if (idrup)
+    message ("checking non-linear IDRUP proof by propagation");
+  else if (propagate)
+    message ("propagating if antecedents are incomplete");
 
   int res;
   if (num_files == 1)
@@ -2565,6 +5827,9 @@ int main (int argc, char **argv) {
   else
     res = parse_and_check_icnf_and_idrup ();
 
+  synchronize_lemma_checks ();
+  stop_workers ();
+
   if (verbosity >= 0)
     fputs ("c\n", stdout);
   if (res)
@@ -2578,9 +5843,10 @@ int main (int argc, char **argv) {
       if (!i)
         fputs ("c\n", stdout);
       message ("closing '%s' after reading %zu lines (%zu bytes)",
-               files[i].name, files[i].lineno - 1, files[i].charno);
+               files[i].name, files[i].lineno - 1,
+               bytes_parsed (files + i));
     }
-    fclose (files[i].file);
+    close_file (files + i);
   }
 
   release ();
@@ -0,0 +1,4 @@
+#define COMPILER "gcc (Debian 12.2.0-14+deb12u1) 12.2.0 -Wall -pthread -O3 -DNDEBUG"
+#define GITID "c8dd55bfe6e2a644e804e9a4b5c6acf4673d966b"
+#define VERSION "0.0.6"
+#define BUILD "Fri Oct 16 03:13:27 UTC 2026 Linux vm 6.18.44-fc-v130 x86_64"
@@ -0,0 +1,729 @@
+// clang-format off
+
+static const char * usage =
+
+"usage: lidrup-convert [ <option> ... ] [ <input> [ <output> ] ]\n"
+"\n"
+"where '<option>' is one of the following options:\n"
+"\n"
+"  -h | --help      print this command line option summary\n"
+"  -b | --binary    produce binary output (default for text input)\n"
+"  -t | --text      produce text output (default for binary input)\n"
+"  -v | --verbose   print statistics after conversion\n"
+"  --icnf           input is an interaction file\n"
+"  --lidrup         input is a proof file\n"
+"  --version        print version and exit\n"
+"\n"
+
+"The converter reads interaction '<icnf>' or proof '<lidrup>' files in\n"
+"either the textual or the binary format (detected by the first byte) and\n"
+"writes them in the other format (unless specified otherwise).  If the\n"
+"'<input>' or '<output>' file is missing or given as '-' then '<stdin>'\n"
+"or '<stdout>' is used instead.\n"
+
+"\n"
+
+"Interaction files do not have clause identifiers in contrast to proof\n"
+"files and thus the converter needs to know which kind of file is read.\n"
+"This is determined by the header line 'p icnf' or 'p lidrup' if present,\n"
+"otherwise by the '.icnf' suffix of the '<input>' path, which can be\n"
+"overwritten by the '--icnf' and '--lidrup' options.\n"
+
+"\n"
+
+"Comments are dropped and omitted line types are made explicit but\n"
+"otherwise converting a file back and forth produces the same file.\n"
+"Conversion is streaming and needs constant memory.\n"
+
+;
+
+// clang-format on
+
+/*------------------------------------------------------------------------*/
+
+#include "lidrup-build.h"
+
+/*------------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*------------------------------------------------------------------------*/
+
+// See the comment before 'next_binary_line_without_printing' in
+// 'lidrup-check.c' for a description of the binary format.
+
+#define BINARY_BIT 0x80
+
+/*------------------------------------------------------------------------*/
+
+// Global command line options.
+
+static int binary_output = -1; // Undetermined (-1), text (0), binary (1).
+static int interactions = -1;  // Undetermined (-1), proof (0), icnf (1).
+static bool verbose;
+
+/*------------------------------------------------------------------------*/
+
+static FILE *input;
+static FILE *output;
+static const char *input_path = "<stdin>";
+static const char *output_path = "<stdout>";
+static bool close_input;
+static bool close_output;
+
+static bool binary_input;
+
+static size_t lineno = 1;       // Line number in text input.
+static size_t start_of_line;    // Line number of the current line.
+static size_t start_of_binary;  // Position of current binary line.
+static int64_t last_read_id;    // Delta decoding base of binary input.
+static int64_t last_written_id; // Delta encoding base of binary output.
+
+static struct {
+  size_t lines;
+  size_t bytes_read;
+  size_t bytes_written;
+} statistics;
+
+/*------------------------------------------------------------------------*/
+
+static void die (const char *, ...) __attribute__ ((format (printf, 1, 2)));
+
+static void die (const char *fmt, ...) {
+  fputs ("lidrup-convert: error: ", stderr);
+  va_list ap;
+  va_start (ap, fmt);
+  vfprintf (stderr, fmt, ap);
+  va_end (ap);
+  fputc ('\n', stderr);
+  exit (1);
+}
+
+static void parse_error (const char *, ...)
+    __attribute__ ((format (printf, 1, 2)));
+
+static void parse_error (const char *fmt, ...) {
+  if (binary_input)
+    fprintf (stderr,
+             "lidrup-convert: parse error: "
+             "in binary line at byte %zu in '%s': ",
+             start_of_binary, input_path);
+  else
+    fprintf (stderr,
+             "lidrup-convert: parse error: at line %zu in '%s': ",
+             start_of_line, input_path);
+  va_list ap;
+  va_start (ap, fmt);
+  vfprintf (stderr, fmt, ap);
+  va_end (ap);
+  fputc ('\n', stderr);
+  exit (1);
+}
+
+/*------------------------------------------------------------------------*/
+
+static bool type_has_id (int t) {
+  return !interactions && (t == 'i' || t == 'l');
+}
+
+static bool type_has_lits (int t) {
+  return t == 'i' || t == 'l' || t == 'q' || t == 'a' || t == 'm' ||
+         t == 'u' || t == 'v' || t == 'f';
+}
+
+static bool type_has_ids (int t) {
+  return !interactions &&
+         (t == 'l' || t == 'd' || t == 'w' || t == 'r' || t == 'u');
+}
+
+static bool valid_type (int t) {
+  return t && strchr ("acdfilmpqrsuvw", t);
+}
+
+/*------------------------------------------------------------------------*/
+
+// Low-level reading and writing of characters.
+
+static inline int read_char (void) {
+  int res = getc_unlocked (input);
+  if (res != EOF)
+    statistics.bytes_read++;
+  return res;
+}
+
+static inline void write_char (int ch) {
+  putc_unlocked (ch, output);
+  statistics.bytes_written++;
+}
+
+/*------------------------------------------------------------------------*/
+
+// Writing lines in text format.
+
+static void write_text_number (int64_t n) {
+  char buffer[24], *p = buffer + sizeof buffer;
+  uint64_t tmp = n < 0 ? -(uint64_t) n : (uint64_t) n;
+  do
+    *--p = '0' + tmp % 10;
+  while (tmp /= 10);
+  if (n < 0)
+    *--p = '-';
+  while (p != buffer + sizeof buffer)
+    write_char (*p++);
+}
+
+static void write_text_space_number (int64_t n) {
+  write_char (' ');
+  write_text_number (n);
+}
+
+/*------------------------------------------------------------------------*/
+
+// Writing lines in binary format.
+
+static void write_binary_number (uint64_t n) {
+  while (n > 0x7f) {
+    write_char ((n & 0x7f) | 0x80);
+    n >>= 7;
+  }
+  write_char (n);
+}
+
+static void write_binary_literal (int64_t lit) {
+  if (lit < -INT_MAX || lit > INT_MAX)
+    parse_error ("literal %" PRId64 " too large", lit);
+  uint64_t idx = lit < 0 ? -lit : lit;
+  write_binary_number (2 * idx + (lit < 0));
+}
+
+static uint64_t delta_encode (int64_t id) {
+  const int64_t last = last_written_id;
+  uint64_t delta = (uint64_t) id - (uint64_t) last;
+  if ((id < last) != ((int64_t) delta < 0))
+    parse_error ("clause identifier %" PRId64 " too far from %" PRId64,
+                 id, last);
+  last_written_id = id;
+  int64_t d = delta;
+  return d < 0 ? 2 * -(uint64_t) d - 1 : 2 * (uint64_t) d;
+}
+
+static void write_binary_id (int64_t id) {
+  write_binary_number (delta_encode (id));
+}
+
+static void write_binary_id_in_list (int64_t id) {
+  uint64_t code = delta_encode (id);
+  if (code == UINT64_MAX)
+    parse_error ("clause identifier %" PRId64 " too far from previous",
+                 id);
+  write_binary_number (code + 1);
+}
+
+/*------------------------------------------------------------------------*/
+
+// Generic line writing functions dispatching on the output format.
+
+static void write_type (int type) {
+  if (binary_output)
+    write_char (type | BINARY_BIT);
+  else
+    write_char (type);
+}
+
+static void write_id (int64_t id) {
+  if (binary_output)
+    write_binary_id (id);
+  else
+    write_text_space_number (id);
+}
+
+static void write_literal (int64_t lit) {
+  if (binary_output)
+    write_binary_literal (lit);
+  else
+    write_text_space_number (lit);
+}
+
+static void write_id_in_list (int64_t id) {
+  if (binary_output)
+    write_binary_id_in_list (id);
+  else
+    write_text_space_number (id);
+}
+
+static void write_zero (void) {
+  if (binary_output)
+    write_char (0);
+  else
+    write_text_space_number (0);
+}
+
+static void write_end_of_line (void) {
+  if (!binary_output)
+    write_char ('\n');
+}
+
+// Headers have up to three optional size hints (maximum variable index,
+// number of clauses and maximum clause identifier).
+
+#define MAX_HINTS 3
+
+static void write_header (const char *name, unsigned num_hints,
+                          const int64_t *hints) {
+  if (binary_output) {
+    write_type ('p');
+    write_char (*name);
+    for (unsigned i = 0; i != num_hints; i++)
+      write_binary_number (hints[i] + 1);
+    write_char (0);
+  } else {
+    write_char ('p');
+    write_char (' ');
+    for (const char *p = name; *p; p++)
+      write_char (*p);
+    for (unsigned i = 0; i != num_hints; i++)
+      write_text_space_number (hints[i]);
+    write_char ('\n');
+  }
+}
+
+static void write_status (int status) {
+  if (binary_output) {
+    write_type ('s');
+    write_binary_number (status);
+  } else {
+    const char *name = status == 10   ? "SATISFIABLE"
+                       : status == 20 ? "UNSATISFIABLE"
+                                      : "UNKNOWN";
+    write_char ('s');
+    write_char (' ');
+    for (const char *p = name; *p; p++)
+      write_char (*p);
+    write_char ('\n');
+  }
+}
+
+/*------------------------------------------------------------------------*/
+
+// Parsing text lines.
+
+static int next_char (void) {
+  int res = read_char ();
+  if (res == '\r') {
+    res = read_char ();
+    if (res != '\n')
+      parse_error ("expected new-line after carriage return");
+  }
+  if (res == '\n')
+    lineno++;
+  return res;
+}
+
+static int skip_spaces (int ch) {
+  while (ch == ' ' || ch == '\t')
+    ch = next_char ();
+  return ch;
+}
+
+static int64_t parse_number (int *ch_ptr, const char *what) {
+  int ch = skip_spaces (*ch_ptr);
+  bool negative = false;
+  if (ch == '-') {
+    negative = true;
+    ch = next_char ();
+  }
+  if (!isdigit (ch))
+    parse_error ("expected %s", what);
+  int64_t res = ch - '0';
+  while (isdigit (ch = next_char ())) {
+    if (!res)
+      parse_error ("invalid leading '0' digit");
+    if (INT64_MAX / 10 < res)
+      parse_error ("%s too large", what);
+    res *= 10;
+    int digit = ch - '0';
+    if (INT64_MAX - digit < res)
+      parse_error ("%s too large", what);
+    res += digit;
+  }
+  if (negative && !res)
+    parse_error ("invalid '-0'");
+  if (ch != ' ' && ch != '\t' && ch != '\n')
+    parse_error ("unexpected character after %s", what);
+  *ch_ptr = ch;
+  return negative ? -res : res;
+}
+
+// Size hints are only used by the checker to preallocate tables and
+// hints which are too large are ignored there.  Thus we do not fail on
+// huge hints either but clamp them to 'INT64_MAX' (which the checker
+// then ignores too).
+
+static int64_t parse_hint (int *ch_ptr) {
+  int ch = skip_spaces (*ch_ptr);
+  if (ch == '-')
+    parse_error ("negative size hint");
+  if (!isdigit (ch))
+    parse_error ("expected size hint");
+  int64_t res = ch - '0';
+  while (isdigit (ch = next_char ())) {
+    if (!res)
+      parse_error ("invalid leading '0' digit");
+    int digit = ch - '0';
+    if (res > (INT64_MAX - digit) / 10)
+      res = INT64_MAX;
+    else
+      res = 10 * res + digit;
+  }
+  if (ch != ' ' && ch != '\t' && ch != '\n')
+    parse_error ("unexpected character after size hint");
+  *ch_ptr = ch;
+  return res;
+}
+
+static int parse_word (int ch, char *word, size_t size) {
+  size_t len = 0;
+  ch = skip_spaces (ch);
+  while (isalpha (ch)) {
+    if (len + 1 == size)
+      parse_error ("word too long");
+    word[len++] = ch;
+    ch = next_char ();
+  }
+  word[len] = 0;
+  return ch;
+}
+
+static void expect_end_of_line (int ch) {
+  if (skip_spaces (ch) != '\n')
+    parse_error ("expected new-line");
+}
+
+static bool convert_text_line (int *default_type) {
+
+  int ch;
+
+  for (;;) {
+    start_of_line = lineno;
+    ch = next_char ();
+    if (ch == 'c') {
+      while ((ch = next_char ()) != '\n')
+        if (ch == EOF)
+          parse_error ("end-of-file in comment");
+    } else if (ch == EOF)
+      return false;
+    else if (ch != '\n')
+      break;
+  }
+
+  int type;
+  if (islower (ch)) {
+    type = ch;
+    if (!valid_type (type))
+      parse_error ("invalid line type '%c'", type);
+    ch = next_char ();
+    if (ch != ' ' && ch != '\t')
+      parse_error ("expected space after '%c'", type);
+  } else
+    type = *default_type;
+
+  if (type == 'p') {
+    char word[16];
+    ch = parse_word (ch, word, sizeof word);
+    if (!strcmp (word, "icnf"))
+      interactions = 1;
+    else if (!strcmp (word, "lidrup"))
+      interactions = 0;
+    else
+      parse_error ("invalid header 'p %s'", word);
+    int64_t hints[MAX_HINTS];
+    unsigned num_hints = 0;
+    while ((ch = skip_spaces (ch)) != '\n') {
+      if (num_hints == MAX_HINTS)
+        parse_error ("too many size hints in header");
+      hints[num_hints++] = parse_hint (&ch);
+    }
+    write_header (word, num_hints, hints);
+    return true;
+  }
+
+  if (type == 's') {
+    char word[16];
+    ch = parse_word (ch, word, sizeof word);
+    expect_end_of_line (ch);
+    int status;
+    if (!strcmp (word, "SATISFIABLE"))
+      status = 10;
+    else if (!strcmp (word, "UNSATISFIABLE"))
+      status = 20;
+    else if (!strcmp (word, "UNKNOWN"))
+      status = 0;
+    else
+      parse_error ("invalid status line 's %s'", word);
+    write_status (status);
+    *default_type = 'i';
+    return true;
+  }
+
+  if (type == 'q' || type == 'a')
+    *default_type = 'l';
+
+  write_type (type);
+
+  if (type_has_id (type)) {
+    int64_t id = parse_number (&ch, "clause identifier");
+    if (id <= 0)
+      parse_error ("expected positive clause identifier");
+    write_id (id);
+  }
+
+  if (type_has_lits (type)) {
+    for (;;) {
+      int64_t lit = parse_number (&ch, "literal");
+      if (lit == INT64_MIN || lit < -INT_MAX || lit > INT_MAX)
+        parse_error ("variable index too large");
+      if (!lit)
+        break;
+      write_literal (lit);
+    }
+    write_zero ();
+  }
+
+  if (type_has_ids (type)) {
+    for (;;) {
+      int64_t id = parse_number (&ch, "antecedent clause identifier");
+      if (!id)
+        break;
+      write_id_in_list (id);
+    }
+    write_zero ();
+  }
+
+  expect_end_of_line (ch);
+  write_end_of_line ();
+  return true;
+}
+
+/*------------------------------------------------------------------------*/
+
+// Parsing binary lines.
+
+static int read_binary_char (const char *what) {
+  int res = read_char ();
+  if (res == EOF)
+    parse_error ("end-of-file in %s", what);
+  return res;
+}
+
+static uint64_t read_binary_number (const char *what) {
+  uint64_t res = 0;
+  for (unsigned shift = 0;; shift += 7) {
+    int ch = read_binary_char (what);
+    if (shift == 63 && (ch & ~1))
+      parse_error ("%s too large", what);
+    res |= (uint64_t) (ch & 0x7f) << shift;
+    if (!(ch & 0x80))
+      return res;
+  }
+}
+
+static int64_t read_binary_id (uint64_t zig_zag, const char *what) {
+  const uint64_t magnitude = zig_zag >> 1;
+  const uint64_t last = last_read_id;
+  uint64_t res;
+  if (zig_zag & 1) {
+    if (magnitude + 1 >= last - (uint64_t) INT64_MIN)
+      parse_error ("%s too small", what);
+    res = last - magnitude - 1;
+  } else {
+    if (magnitude > (uint64_t) INT64_MAX - last)
+      parse_error ("%s too large", what);
+    res = last + magnitude;
+  }
+  if (!res)
+    parse_error ("zero %s", what);
+  last_read_id = res;
+  return res;
+}
+
+static bool convert_binary_line (void) {
+
+  start_of_binary = statistics.bytes_read;
+  int ch = read_char ();
+  if (ch == EOF)
+    return false;
+
+  int type = ch & ~BINARY_BIT;
+  if (!(ch & BINARY_BIT) || !valid_type (type))
+    parse_error ("invalid binary line type byte %02x", ch);
+
+  if (type == 'p') {
+    ch = read_binary_char ("header");
+    const char *name;
+    if (ch == 'i')
+      name = "icnf", interactions = 1;
+    else if (ch == 'l')
+      name = "lidrup", interactions = 0;
+    else
+      parse_error ("invalid binary 'p' header line");
+    int64_t hints[MAX_HINTS];
+    unsigned num_hints = 0;
+    for (uint64_t hint; (hint = read_binary_number ("header"));) {
+      if (num_hints == MAX_HINTS)
+        parse_error ("expected zero after binary '%s' header", name);
+      hints[num_hints++] = hint - 1 > INT64_MAX ? INT64_MAX : hint - 1;
+    }
+    write_header (name, num_hints, hints);
+    return true;
+  }
+
+  if (type == 's') {
+    uint64_t status = read_binary_number ("status");
+    if (status != 0 && status != 10 && status != 20)
+      parse_error ("invalid binary status line");
+    write_status (status);
+    return true;
+  }
+
+  write_type (type);
+
+  if (type_has_id (type)) {
+    uint64_t code = read_binary_number ("clause identifier");
+    int64_t id = read_binary_id (code, "clause identifier");
+    if (id < 0)
+      parse_error ("expected non-negative clause identifier");
+    write_id (id);
+  }
+
+  if (type_has_lits (type)) {
+    for (;;) {
+      uint64_t code = read_binary_number ("literal");
+      if (!code)
+        break;
+      uint64_t idx = code >> 1;
+      if (!idx)
+        parse_error ("invalid binary literal encoding %" PRIu64, code);
+      if (idx > INT_MAX)
+        parse_error ("variable index too large");
+      write_literal ((code & 1) ? -(int64_t) idx : (int64_t) idx);
+    }
+    write_zero ();
+  }
+
+  if (type_has_ids (type)) {
+    for (;;) {
+      uint64_t code = read_binary_number ("antecedent clause identifier");
+      if (!code)
+        break;
+      write_id_in_list (
+          read_binary_id (code - 1, "antecedent clause identifier"));
+    }
+    write_zero ();
+  }
+
+  write_end_of_line ();
+  return true;
+}
+
+/*------------------------------------------------------------------------*/
+
+static bool has_suffix (const char *str, const char *suffix) {
+  size_t l = strlen (str), k = strlen (suffix);
+  return l >= k && !strcmp (str + l - k, suffix);
+}
+
+int main (int argc, char **argv) {
+
+  for (int i = 1; i != argc; i++) {
+    const char *arg = argv[i];
+    if (!strcmp (arg, "-h") || !strcmp (arg, "--help")) {
+      fputs (usage, stdout);
+      exit (0);
+    } else if (!strcmp (arg, "-b") || !strcmp (arg, "--binary"))
+      binary_output = 1;
+    else if (!strcmp (arg, "-t") || !strcmp (arg, "--text"))
+      binary_output = 0;
+    else if (!strcmp (arg, "-v") || !strcmp (arg, "--verbose"))
+      verbose = true;
+    else if (!strcmp (arg, "--icnf"))
+      interactions = 1;
+    else if (!strcmp (arg, "--lidrup"))
+      interactions = 0;
+    else if (!strcmp (arg, "--version"))
+      printf ("%s\n", lidrup_version), exit (0);
+    else if (arg[0] == '-' && arg[1])
+      die ("invalid command line option '%s' (try '-h')", arg);
+    else if (!input) {
+      if (!strcmp (arg, "-"))
+        input = stdin;
+      else if (!(input = fopen (arg, "r")))
+        die ("can not read '%s'", arg);
+      else {
+        input_path = arg;
+        close_input = true;
+      }
+    } else if (!output) {
+      if (!strcmp (arg, "-"))
+        output = stdout;
+      else if (!(output = fopen (arg, "w")))
+        die ("can not write '%s'", arg);
+      else {
+        output_path = arg;
+        close_output = true;
+      }
+    } else
+      die ("too many files '%s', '%s' and '%s'", input_path, output_path,
+           arg);
+  }
+
+  if (!input)
+    input = stdin;
+  if (!output)
+    output = stdout;
+
+  if (interactions < 0)
+    interactions = has_suffix (input_path, ".icnf");
+
+  int ch = getc_unlocked (input);
+  if (ch != EOF) {
+    binary_input = (ch & BINARY_BIT);
+    ungetc (ch, input);
+  }
+
+  if (binary_output < 0)
+    binary_output = !binary_input;
+
+  if (binary_input)
+    while (convert_binary_line ())
+      statistics.lines++;
+  else {
+    int default_type = 'i';
+    while (convert_text_line (&default_type))
+      statistics.lines++;
+  }
+
+  if (close_input)
+    fclose (input);
+  if (fflush (output) || (close_output && fclose (output)))
+    die ("writing to '%s' failed", output_path);
+
+  if (verbose)
+    fprintf (stderr,
+             "lidrup-convert: converted %zu lines from %s '%s' "
+             "(%zu bytes) to %s '%s' (%zu bytes)\n",
+             statistics.lines, binary_input ? "binary" : "text",
+             input_path, statistics.bytes_read,
+             binary_output ? "binary" : "text", output_path,
+             statistics.bytes_written);
+
+  return 0;
+}
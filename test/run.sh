@@ -70,6 +70,12 @@ run 0 example1
 run 0 example2
 run 0 example3
 run 0 weaken
+run 0 epochs
+run 0 inlined
+run 0 widths
+run 0 nonlinear
+run 0 units
+run 0 rootunits
 run 0 dp2
 run 0 dp3
 run 0 dp4
@@ -81,14 +87,230 @@ run 0 regr3
 
 run 0 cnt2re
 
+run 0 binary1
+run 0 hints
+run 0 hugehints
+run 0 bighints
+
 run 1 litnotincore
 run 1 twice
 run 1 invalidempty
 run 1 invalidfull2
 run 1 invalideleted
+run 1 backward
+run 1 needed
+run 1 unused
+run 1 propagate
+run 1 unitdeleted
+run 1 rootuncited
+run 1 rootfalsified
 
 files="`expr $files + 1`"
 
 done
 
+pipe () {
+  expected=$1
+  icnf=test/$2.icnf
+  proof=test/$2.lidrup
+  log=test/$2.log
+  err=test/$2.err
+  printf "%s" "cat $proof | ./$binary $icnf -"
+  cat $proof | ./$binary $icnf - 1>$log 2>$err
+  actual=$?
+  [ $actual = $expected ] || \
+    die "exit status '$actual' but expected '$expected'"
+  echo " # succeeded"
+  printf "%s" "cat $icnf | ./$binary - $proof"
+  cat $icnf | ./$binary - $proof 1>$log 2>$err
+  actual=$?
+  [ $actual = $expected ] || \
+    die "exit status '$actual' but expected '$expected'"
+  echo " # succeeded"
+  passed=`expr $passed + 2`
+}
+
+pipe 0 example3
+pipe 0 ifull3
+
+fifo () {
+  expected=$1
+  icnf=test/$2.icnf
+  proof=test/$2.lidrup
+  log=test/$2.log
+  err=test/$2.err
+  fifos="test/$2.icnf.fifo test/$2.lidrup.fifo"
+  rm -f $fifos
+  mkfifo $fifos || die "could not create named pipes '$fifos'"
+  printf "%s" "./$binary -v $fifos"
+  cat $icnf > test/$2.icnf.fifo &
+  cat $proof > test/$2.lidrup.fifo &
+  ./$binary -v $fifos 1>$log 2>$err
+  actual=$?
+  wait
+  rm -f $fifos
+  [ $actual = $expected ] || \
+    die "exit status '$actual' but expected '$expected'"
+  grep -q "without limit" $log || \
+    die "named pipes not read without limit"
+  echo " # succeeded"
+  passed=`expr $passed + 1`
+}
+
+fifo 0 example3
+fifo 0 ifull3
+fifo 1 litnotincore
+
+cmd="./$binary --follow test/example2.icnf test/example2.lidrup"
+printf "%s" "$cmd"
+$cmd 1>test/example2.log 2>test/example2.err || die "following failed"
+echo " # succeeded"
+passed=`expr $passed + 1`
+
+# The proof is still written while it is checked.  The background writer
+# opens the file before the checker starts and only closes it after the
+# last part has been appended.  The checker also receives 'SIGIO' (as if
+# a probing lease was broken) which it has to ignore.
+
+growing=test/growing.lidrup
+cmd="./$binary --follow test/example2.icnf $growing"
+printf "%s" "$cmd"
+exec 3>$growing
+(head -n 12 test/example2.lidrup; sleep 1; tail -n +13 test/example2.lidrup) \
+  >&3 &
+exec 3>&-
+$cmd 1>test/example2.log 2>test/example2.err &
+checker=$!
+sleep 0.5
+kill -IO $checker
+wait $checker
+actual=$?
+wait
+rm -f $growing
+[ $actual = 0 ] || die "following growing proof failed"
+echo " # succeeded"
+passed=`expr $passed + 1`
+
+if gzip --version >/dev/null 2>&1
+then
+  compressed="test/quote'd.lidrup.gz"
+  gzip -c test/example2.lidrup > "$compressed" || \
+    die "could not compress 'test/example2.lidrup'"
+  printf "%s" "./$binary test/example2.icnf \"$compressed\""
+  ./$binary test/example2.icnf "$compressed" \
+    1>test/example2.log 2>test/example2.err || \
+    die "checking compressed proof failed"
+  echo " # succeeded"
+  passed=`expr $passed + 1`
+fi
+
+option () {
+  option=$1
+  expected=$2
+  icnf=test/$3.icnf
+  proof=test/$3.lidrup
+  log=test/$3.log
+  err=test/$3.err
+  cmd="./$binary $option $proof"
+  test -f $icnf && cmd="./$binary $option $icnf $proof"
+  printf "%s" "$cmd"
+  $cmd 1>$log 2>$err
+  actual=$?
+  [ $actual = $expected ] || \
+    die "exit status '$actual' but expected '$expected'"
+  echo " # succeeded"
+  passed=`expr $passed + 1`
+}
+
+option "--threads 2" 0 dp4
+option "--threads 2" 0 cnt2re
+option "--threads 2" 0 inlined
+option "--threads 2" 1 invalidempty
+option "--threads 2" 1 unitdeleted
+option "--threads 2" 0 rootunits
+option "--threads 2" 1 rootuncited
+option "--threads 2" 1 rootfalsified
+
+option --backward 0 dp4
+option --backward 0 cnt2re
+option --backward 0 invalidempty
+option --backward 0 backward
+option --backward 0 unitdeleted
+option --backward 1 needed
+option --backward 0 unused
+grep -q "^c skipped: *2 " test/unused.log || \
+  die "expected two skipped lemmas in 'test/unused.log'"
+
+option --propagate 0 dp4
+option --propagate 0 propagate
+option --propagate 0 units
+option --propagate 0 rootfalsified
+option --propagate 1 invalidempty
+
+option --no-reuse 0 hugehints
+option --no-reuse 0 bighints
+
+compact () {
+  option "$1" $2 $3
+  grep -q "^c compactions: *[1-9]" test/$3.log || \
+    die "clauses not compacted in 'test/$3.log'"
+}
+
+compact "--compact 0" 0 compact
+option "--compact 0 --threads 2" 0 compact
+compact "--compact 0 --backward" 0 compact
+compact "--compact 0 --propagate" 0 compactpropagate
+option "--compact 0" 1 compactpropagate
+
+failure () {
+  option "$1" 1 $2
+  grep -q "$3" test/$2.err || die "expected '$3' in 'test/$2.err'"
+}
+
+failure "" idrupnotrup "lemma resolution check failed"
+failure "" idrupdelete "could not find and delete clause"
+failure "" idrupweaken "could not find and weaken clause"
+failure "" idruprestore "could not find and restore weakened clause"
+failure "--threads 2" nonlinear "can not check IDRUP proof with '--threads'"
+failure --backward nonlinear "can not check IDRUP proof with '--backward'"
+
+converter=lidrup-convert
+
+convert () {
+  name=$2
+  for suffix in icnf lidrup
+  do
+    src=test/$name.$suffix
+    test -f $src || continue
+    dst=test/$name.bin.$suffix
+    txt=test/$name.txt.$suffix
+    cmd="./$converter --$suffix $src $dst"
+    printf "%s" "$cmd"
+    $cmd || die "converting '$src' to binary format failed"
+    echo " # succeeded"
+    cmd="./$converter --$suffix $dst $txt"
+    printf "%s" "$cmd"
+    $cmd || die "converting '$dst' back to text format failed"
+    echo " # succeeded"
+    cmd="./$converter --$suffix $txt"
+    printf "%s" "$cmd"
+    $cmd | cmp -s - $dst || die "converting '$txt' differs from '$dst'"
+    echo " # succeeded"
+    passed=`expr $passed + 3`
+  done
+  files=1
+  run $1 $name.bin
+  files=2
+  run $1 $name.bin
+}
+
+if [ -f ./$converter ]
+then
+  convert 0 example2
+  convert 0 dp4
+  convert 0 bighints
+  convert 0 hugehints
+  convert 1 twice
+fi
+
 echo "all $passed tests passed"